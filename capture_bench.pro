@@ -0,0 +1,13 @@
+# Window capture and discovery latency harness (Linux)
+# Build with qmake capture_bench.pro && make
+# Run under Xvfb: xvfb-run -s "-screen 0 1920x1080x24" build/capture_bench
+
+include(track-o-bot.pro)
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = capture_bench
+
+SOURCES -= src/Main.cpp
+SOURCES += test/CaptureBench.cpp
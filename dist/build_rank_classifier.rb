@@ -0,0 +1,58 @@
+#!/usr/bin/env ruby
+
+# Convert the pretrained rank classifier (JSON) into the compact binary
+# model which is embedded as a resource and loaded by RankClassifier
+#
+# Layout (little-endian):
+#   char[4]  magic "TOBM"
+#   uint32   version
+#   uint32   number of layers
+#   per layer:
+#     uint32   type (MLP::LayerType)
+#     uint32   number of inputs
+#     uint32   number of outputs
+#     float32  biases[outputs]
+#     float32  weights[outputs][inputs] (row-major)
+
+require 'json'
+
+MAGIC = 'TOBM'
+VERSION = 1
+
+# Must match MLP::LayerType
+LAYER_TYPES = {
+  'SIGMOID'   => 0,
+  'SOFTMAX'   => 1,
+  'RECTIFIER' => 2
+}
+
+src = ARGV[0] || 'data/rank_classifier.json'
+dst = ARGV[1] || 'data/rank_classifier.bin'
+
+layers = JSON.parse(File.read(src))
+
+File.open(dst, 'wb') do |f|
+  f.write [MAGIC, VERSION, layers.size].pack('a4VV')
+
+  # Layers are applied in key order (same as QJsonObject iteration)
+  layers.keys.sort.each do |name|
+    layer = layers[name]
+
+    type = LAYER_TYPES.fetch(layer['type']) { abort "Unknown layer type #{layer['type']}" }
+    weights = layer['weights']
+    biases = layer['biases']
+    outputs = weights.size
+    inputs = weights.first.size
+
+    abort "Bias count mismatch in #{name}" unless biases.size == outputs
+    abort "Ragged weight matrix in #{name}" unless weights.all? { |row| row.size == inputs }
+
+    f.write [type, inputs, outputs].pack('VVV')
+    f.write biases.pack('e*')
+    f.write weights.flatten.pack('e*')
+
+    puts "#{name}: #{inputs}x#{outputs} (#{layer['type']})"
+  end
+end
+
+puts "Wrote #{dst} (#{File.size(dst)} bytes)"
@@ -0,0 +1,18 @@
+# Rank classifier model throughput, fp32 vs int8 (no Qt needed)
+# Build with qmake mlp_bench.pro && make, run build/mlp_bench data/rank_classifier.bin
+# Add QMAKE_CXXFLAGS+=-mavx2 (or -mssse3) to qmake to measure those kernels
+
+CONFIG += console c++11 release
+CONFIG -= app_bundle qt
+
+TEMPLATE = app
+TARGET = mlp_bench
+
+DESTDIR = build
+OBJECTS_DIR = tmp/mlp_bench
+
+INCLUDEPATH += src
+
+HEADERS = src/MLP.h
+SOURCES = src/MLP.cpp \
+          test/MLPBench.cpp
@@ -0,0 +1,13 @@
+# Rank classifier speed and accuracy harness
+# Build with qmake rank_bench.pro && make, run build/rank_bench <crops directory>
+
+include(track-o-bot.pro)
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = rank_bench
+
+SOURCES -= src/Main.cpp
+HEADERS += test/QuantizableRankClassifier.h
+SOURCES += test/RankClassifierBench.cpp
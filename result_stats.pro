@@ -0,0 +1,12 @@
+# Winrates from the local result store on the command line, --export writes it as Parquet files
+# Build with qmake result_stats.pro && make, run build/result_stats --help
+
+include(track-o-bot.pro)
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = result_stats
+
+SOURCES -= src/Main.cpp
+SOURCES += src/ResultStatsMain.cpp
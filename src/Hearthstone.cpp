@@ -44,7 +44,10 @@ Hearthstone::Hearthstone()
   mCapture = new WinWindowCapture();
 #elif defined Q_OS_LINUX
  LOG("GNU/Linux host");
- mCapture = new LinuxWindowCapture();
+ LinuxWindowCapture *linuxCapture = new LinuxWindowCapture();
+ // Window changes are pushed by X events, no need to poll quickly
+ connect( linuxCapture, &LinuxWindowCapture::WindowChanged, this, &Hearthstone::Update, Qt::QueuedConnection );
+ mCapture = linuxCapture;
 #endif
 
   // On OS X, WindowFound is quite CPU intensive
@@ -113,6 +116,12 @@ void Hearthstone::SetSlowUpdates() {
 }
 
 void Hearthstone::SetFastUpdates() {
+  // Window changes arrive by themselves, e.g. from X events
+  if( mCapture->ReportsWindowChanges() ) {
+    SetSlowUpdates();
+    return;
+  }
+
   DBG( "Hearthstone::SetFastUpdates" );
   mTimer->setInterval( FAST_UPDATE_INTERVAL );
 }
@@ -166,7 +175,7 @@ bool Hearthstone::CaptureWholeScreen( QPixmap *screen ) {
   return true;
 }
 
-QPixmap Hearthstone::Capture( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch )
+QRect Hearthstone::CaptureRect( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch ) const
 {
   UNUSED_ARG( canvasWidth );
 
@@ -181,7 +190,26 @@ QPixmap Hearthstone::Capture( int canvasWidth, int canvasHeight, int cx, int cy,
   w = roundf( cw * scale );
   h = roundf( ch * scale );
 
-  return mCapture->Capture( x, y, w, h );
+  return QRect( x, y, w, h );
+}
+
+QPixmap Hearthstone::Capture( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch )
+{
+  QRect rect = CaptureRect( canvasWidth, canvasHeight, cx, cy, cw, ch );
+  return mCapture->Capture( rect.x(), rect.y(), rect.width(), rect.height() );
+}
+
+QImage Hearthstone::CaptureImage( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch )
+{
+  QRect rect = CaptureRect( canvasWidth, canvasHeight, cx, cy, cw, ch );
+  return mCapture->CaptureImage( rect.x(), rect.y(), rect.width(), rect.height() );
+}
+
+// Scaled to the size of target, see WindowCapture::CaptureInto
+bool Hearthstone::CaptureInto( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch, QImage *target )
+{
+  QRect rect = CaptureRect( canvasWidth, canvasHeight, cx, cy, cw, ch );
+  return mCapture->CaptureInto( rect.x(), rect.y(), rect.width(), rect.height(), target );
 }
 
 void Hearthstone::SetWindowCapture( WindowCapture *windowCapture ) {
@@ -189,6 +217,13 @@ void Hearthstone::SetWindowCapture( WindowCapture *windowCapture ) {
     delete mCapture;
 
   mCapture = windowCapture;
+
+#ifndef Q_OS_MAC
+  // The new capture might need polling (or not)
+  if( mGameRunning ) {
+    SetFastUpdates();
+  }
+#endif
 }
 
 void Hearthstone::EnableLogging() {
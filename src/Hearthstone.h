@@ -30,6 +30,7 @@ private:
   int mBuild;
 
   QString ReadAgentAttribute( const char *attributeName ) const;
+  QRect CaptureRect( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch ) const;
   void DetectBuild();
   QTimer *mTimer;
 
@@ -39,6 +40,8 @@ public:
 
   bool GameRunning() const;
   QPixmap Capture( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch  );
+  QImage CaptureImage( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch );
+  bool CaptureInto( int canvasWidth, int canvasHeight, int cx, int cy, int cw, int ch, QImage *target );
   bool CaptureWholeScreen( QPixmap *screen );
 
   void EnableLogging();
@@ -0,0 +1,86 @@
+#include "LinuxProcessFinder.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+
+// Linux truncates comm to 15 characters
+#define COMM_MAX_LENGTH 15
+
+// Enough for the wine loader and a windows path to the executable
+#define CMDLINE_MAX_SIZE 1024
+
+LinuxProcessFinder::LinuxProcessFinder( const QString& processName, const QString& procPath )
+  : mProcessName( processName ), mProcPath( procPath ), mPid( 0 )
+{
+  mAvailable = QDir( mProcPath ).exists();
+}
+
+bool LinuxProcessFinder::Available() const {
+  return mAvailable;
+}
+
+qint64 LinuxProcessFinder::Pid() const {
+  return mPid;
+}
+
+bool LinuxProcessFinder::Running() {
+  if( !mAvailable )
+    return false;
+
+  // A single small read while the process keeps running
+  if( mPid && IsProcess( QString::number( mPid ) ) )
+    return true;
+
+  mPid = 0;
+  return Scan();
+}
+
+bool LinuxProcessFinder::Scan() {
+  // Only the top level pid directories, without sorting or stat'ing every entry
+  QDirIterator it( mProcPath, QDir::Dirs | QDir::NoDotAndDotDot );
+  while( it.hasNext() ) {
+    it.next();
+
+    QString name = it.fileName();
+    if( name.isEmpty() || !name[ 0 ].isDigit() )
+      continue;
+
+    if( IsProcess( name ) ) {
+      mPid = name.toLongLong();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LinuxProcessFinder::IsProcess( const QString& pid ) const {
+  QByteArray comm = ReadEntry( pid, "comm", COMM_MAX_LENGTH + 1 ).trimmed();
+  if( comm.isEmpty() )
+    return false;
+
+  if( !mProcessName.left( COMM_MAX_LENGTH ).compare( QString::fromLocal8Bit( comm ), Qt::CaseInsensitive ) )
+    return true;
+
+  // wine, wine64, wine-preloader, wine64-preloader
+  if( !comm.startsWith( "wine" ) )
+    return false;
+
+  // argv[0] is the windows path of the executable
+  QByteArray cmdline = ReadEntry( pid, "cmdline", CMDLINE_MAX_SIZE );
+  foreach( const QByteArray& arg, cmdline.split( '\0' ) ) {
+    QString path = QString::fromLocal8Bit( arg ).replace( '\\', '/' );
+    if( !path.section( '/', -1 ).compare( mProcessName, Qt::CaseInsensitive ) )
+      return true;
+  }
+  return false;
+}
+
+QByteArray LinuxProcessFinder::ReadEntry( const QString& pid, const char *entry, qint64 maxSize ) const {
+  // Files in /proc report a size of 0, so read up to maxSize
+  QFile file( mProcPath + "/" + pid + "/" + entry );
+  if( !file.open( QIODevice::ReadOnly ) )
+    return QByteArray();
+
+  return file.read( maxSize );
+}
@@ -0,0 +1,48 @@
+#ifndef LINUXPROCESSFINDER_H
+#define LINUXPROCESSFINDER_H
+
+#include <QString>
+
+/**
+ * @brief Looks for a running process by name in /proc
+ *
+ * Wine names its processes after the executable, so
+ * Hearthstone shows up as Hearthstone.exe in /proc/<pid>/comm
+ * (older versions keep wine-preloader and only the command line
+ * tells the executable).
+ *
+ * Once found, the pid is remembered and only that entry is
+ * checked until the process is gone.
+ */
+class LinuxProcessFinder {
+public:
+  LinuxProcessFinder( const QString& processName, const QString& procPath = "/proc" );
+
+  /**
+   * @brief Whether /proc could be read at all
+   * @return false if the caller has to find the process some other way
+   */
+  bool Available() const;
+  /**
+   * @brief Checks if the process is running
+   * @return true if found
+   */
+  bool Running();
+  /**
+   * @brief Pid of the process found by the last call to Running
+   * @return pid or 0
+   */
+  qint64 Pid() const;
+
+private:
+  QString mProcessName;
+  QString mProcPath;
+  qint64 mPid;
+  bool mAvailable;
+
+  bool Scan();
+  bool IsProcess( const QString& pid ) const;
+  QByteArray ReadEntry( const QString& pid, const char *entry, qint64 maxSize ) const;
+};
+
+#endif // LINUXPROCESSFINDER_H
@@ -1,27 +1,200 @@
 #include <QGuiApplication>
+#include <QCoreApplication>
 #include <QScreen>
 #include <QX11Info>
+#include <QVector>
 #include "LinuxWindowCapture.h"
 #include <xcb/xcb_icccm.h>
 
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
 #define WM_WINDOW_INSTANCE "Hearthstone.exe"
 #define WM_CLASS "Hearthstone.exe"
 
 LinuxWindowCapture::LinuxWindowCapture()
-  : mWindow( XCB_WINDOW_NONE ), mFocus( false )
+  : mWindow( XCB_WINDOW_NONE ), mFocus( false ),
+    mProcessFinder( WM_WINDOW_INSTANCE ), mProcessRunning( false ),
+    mEventsAvailable( false ), mTracking( false ), mActiveWindowAtom( XCB_ATOM_NONE ),
+    mShmAvailable( false ), mShmSeg( 0 ), mShmId( -1 ), mShmData( NULL ), mShmSize( 0 )
 {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  const xcb_query_extension_reply_t *shmExt = xcb_get_extension_data( xcbConn, &xcb_shm_id );
+  mShmAvailable = shmExt && shmExt->present;
+  if( !mShmAvailable ) {
+    LOG( "MIT-SHM not available, falling back to regular screen grabs" );
+  }
+
+  // Without an application there is no event loop to deliver X events
+  if( QCoreApplication::instance() ) {
+    QCoreApplication::instance()->installNativeEventFilter( this );
+    mEventsAvailable = true;
+  }
+}
+
+LinuxWindowCapture::~LinuxWindowCapture() {
+  if( QCoreApplication::instance() )
+    QCoreApplication::instance()->removeNativeEventFilter( this );
+
+  ReleaseShmSegment();
 }
 
 bool LinuxWindowCapture::WindowFound() {
+  // Events keep mWindow, mRect and mFocus up to date
+  if( mTracking )
+    return true;
+
+  if( !mWindow && mProcessFinder.Available() ) {
+    bool running = mProcessFinder.Running();
+    if( running != mProcessRunning ) {
+      mProcessRunning = running;
+      if( running ) {
+        LOG( "Hearthstone process found (pid %lld)", mProcessFinder.Pid() );
+      }
+    }
+
+    // No window without the process, skip the window tree search
+    if( !running )
+      return false;
+  }
+
   if ( !mWindow )
     mWindow = FindWindow( WM_WINDOW_INSTANCE, WM_CLASS );
 
   if ( mWindow && !ExtractWindowProperties( mWindow, &mRect, &mFocus) )
     mWindow = XCB_WINDOW_NONE;
 
+  if( mWindow && mEventsAvailable )
+    TrackWindow();
+
   return mWindow != XCB_WINDOW_NONE;
 }
 
+// Add to the event mask of our connection, without dropping
+// events Qt already selected (e.g. on the root window)
+void LinuxWindowCapture::SelectEvents( xcb_window_t winId, uint32_t mask ) {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+
+  xcb_get_window_attributes_cookie_t attrC = xcb_get_window_attributes( xcbConn, winId );
+  CScopedPointer< xcb_get_window_attributes_reply_t > attrR( xcb_get_window_attributes_reply( xcbConn, attrC, nullptr ) );
+  if( attrR )
+    mask |= attrR->your_event_mask;
+
+  xcb_change_window_attributes( xcbConn, winId, XCB_CW_EVENT_MASK, &mask );
+  xcb_flush( xcbConn );
+}
+
+void LinuxWindowCapture::TrackWindow() {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+
+  if( mActiveWindowAtom == XCB_ATOM_NONE ) {
+    const char name[] = "_NET_ACTIVE_WINDOW";
+    xcb_intern_atom_cookie_t atomC = xcb_intern_atom( xcbConn, true, sizeof( name ) - 1, name );
+    CScopedPointer< xcb_intern_atom_reply_t > atomR( xcb_intern_atom_reply( xcbConn, atomC, nullptr ) );
+    if( atomR )
+      mActiveWindowAtom = atomR->atom;
+
+    SelectEvents( QX11Info::appRootWindow(), XCB_EVENT_MASK_PROPERTY_CHANGE );
+  }
+
+  SelectEvents( mWindow, XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_FOCUS_CHANGE );
+  mTracking = true;
+
+  // The window could have changed between the first query and selecting events
+  RefreshGeometry();
+  RefreshFocus();
+}
+
+void LinuxWindowCapture::RefreshGeometry() {
+  if( !ExtractWindowGeometry( mWindow, &mRect ) ) {
+    WindowLost();
+  }
+}
+
+void LinuxWindowCapture::RefreshFocus() {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  xcb_get_input_focus_cookie_t focusC = xcb_get_input_focus( xcbConn );
+  CScopedPointer < xcb_get_input_focus_reply_t > focusR( xcb_get_input_focus_reply( xcbConn, focusC, nullptr ) );
+  if( focusR )
+    mFocus = ( focusR->focus == mWindow );
+}
+
+void LinuxWindowCapture::WindowLost() {
+  mWindow = XCB_WINDOW_NONE;
+  mTracking = false;
+  mFocus = false;
+}
+
+bool LinuxWindowCapture::nativeEventFilter( const QByteArray& eventType, void *message, long *result ) {
+  Q_UNUSED( result );
+
+  if( !mTracking || eventType != "xcb_generic_event_t" )
+    return false;
+
+  xcb_generic_event_t *event = static_cast< xcb_generic_event_t* >( message );
+  bool synthetic = event->response_type & 0x80;
+
+  QRect rect = mRect;
+  bool focus = mFocus;
+
+  switch( event->response_type & ~0x80 ) {
+    case XCB_CONFIGURE_NOTIFY: {
+      xcb_configure_notify_event_t *configure = reinterpret_cast< xcb_configure_notify_event_t* >( event );
+      if( configure->window != mWindow )
+        break;
+
+      if( synthetic ) {
+        // Sent by the window manager, coordinates are relative to the root (ICCCM 4.1.5)
+        mRect.setRect( configure->x, configure->y, configure->width, configure->height );
+      } else {
+        // Relative to the parent, which is usually a frame
+        RefreshGeometry();
+      }
+    } break;
+
+    case XCB_REPARENT_NOTIFY: {
+      xcb_reparent_notify_event_t *reparent = reinterpret_cast< xcb_reparent_notify_event_t* >( event );
+      if( reparent->window == mWindow )
+        RefreshGeometry();
+    } break;
+
+    case XCB_DESTROY_NOTIFY: {
+      xcb_destroy_notify_event_t *destroy = reinterpret_cast< xcb_destroy_notify_event_t* >( event );
+      if( destroy->window == mWindow ) {
+        WindowLost();
+      }
+    } break;
+
+    case XCB_FOCUS_IN: {
+      xcb_focus_in_event_t *focusIn = reinterpret_cast< xcb_focus_in_event_t* >( event );
+      if( focusIn->event == mWindow && focusIn->detail != XCB_NOTIFY_DETAIL_POINTER )
+        mFocus = true;
+    } break;
+
+    case XCB_FOCUS_OUT: {
+      xcb_focus_out_event_t *focusOut = reinterpret_cast< xcb_focus_out_event_t* >( event );
+      if( focusOut->event == mWindow &&
+          focusOut->detail != XCB_NOTIFY_DETAIL_POINTER &&
+          focusOut->detail != XCB_NOTIFY_DETAIL_INFERIOR )
+        mFocus = false;
+    } break;
+
+    case XCB_PROPERTY_NOTIFY: {
+      xcb_property_notify_event_t *property = reinterpret_cast< xcb_property_notify_event_t* >( event );
+      if( property->window == QX11Info::appRootWindow() &&
+          property->atom == mActiveWindowAtom && mActiveWindowAtom != XCB_ATOM_NONE )
+        RefreshFocus();
+    } break;
+  }
+
+  if( !mTracking || rect != mRect || focus != mFocus ) {
+    emit WindowChanged();
+  }
+
+  // Let Qt see the events as well
+  return false;
+}
+
 int LinuxWindowCapture::Width() {
   return mRect.width();
 }
@@ -39,29 +212,180 @@ int LinuxWindowCapture::Top() {
 }
 
 QPixmap LinuxWindowCapture::Capture( int x, int y, int w, int h ) {
-    LOG("Capturing window: %d, %d, %d, %d", x, y, h, w );
-    QScreen *screen = QGuiApplication::primaryScreen();
-    QPixmap pixmap = screen->grabWindow( mWindow, x, y, w, h );
-  return pixmap;
+  return QPixmap::fromImage( CaptureImage( x, y, w, h ) );
+}
+
+QImage LinuxWindowCapture::CaptureImage( int x, int y, int w, int h ) {
+  QImage image( w, h, QImage::Format_RGB32 );
+  if( w <= 0 || h <= 0 || !CaptureInto( x, y, w, h, &image ) )
+    return QImage();
+  return image;
+}
+
+bool LinuxWindowCapture::CaptureInto( int x, int y, int w, int h, QImage *target ) {
+  if( mShmAvailable && CaptureShm( x, y, w, h, target ) )
+    return true;
+
+  QScreen *screen = QGuiApplication::primaryScreen();
+  return CopyScaled( screen->grabWindow( mWindow, x, y, w, h ).toImage(), target );
+}
+
+bool LinuxWindowCapture::EnsureShmSegment( size_t size ) {
+  if( mShmData && mShmSize >= size )
+    return true;
+
+  ReleaseShmSegment();
+
+  xcb_connection_t* xcbConn = QX11Info::connection();
+
+  mShmId = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+  if( mShmId == -1 ) {
+    ERR( "shmget failed. Disable MIT-SHM capture" );
+    mShmAvailable = false;
+    return false;
+  }
+
+  void *data = shmat( mShmId, NULL, 0 );
+  if( data == ( void* )-1 ) {
+    ERR( "shmat failed. Disable MIT-SHM capture" );
+    shmctl( mShmId, IPC_RMID, NULL );
+    mShmId = -1;
+    mShmAvailable = false;
+    return false;
+  }
+
+  mShmSeg = xcb_generate_id( xcbConn );
+  CScopedPointer< xcb_generic_error_t > error( xcb_request_check( xcbConn,
+        xcb_shm_attach_checked( xcbConn, mShmSeg, mShmId, false ) ) );
+
+  // Segment is freed once both sides detached
+  shmctl( mShmId, IPC_RMID, NULL );
+
+  if( error ) {
+    ERR( "Could not attach shared memory segment (X error %d). Disable MIT-SHM capture", error->error_code );
+    shmdt( data );
+    mShmId = -1;
+    mShmAvailable = false;
+    return false;
+  }
+
+  mShmData = static_cast< uchar* >( data );
+  mShmSize = size;
+  return true;
 }
 
-QList< xcb_window_t > LinuxWindowCapture::listWindowsRecursive( const xcb_window_t& window ) {
+void LinuxWindowCapture::ReleaseShmSegment() {
+  if( !mShmData )
+    return;
+
+  xcb_shm_detach( QX11Info::connection(), mShmSeg );
+  shmdt( mShmData );
+
+  mShmData = NULL;
+  mShmSize = 0;
+  mShmId = -1;
+}
+
+// Read the window contents straight into the shared segment
+// and scale / copy from there into the target, which is reused
+bool LinuxWindowCapture::CaptureShm( int x, int y, int w, int h, QImage *target ) {
+  if( !mWindow || w <= 0 || h <= 0 || target->isNull() )
+    return false;
+
+  // ZPixmap with 24/32 bit depth uses 4 bytes per pixel
+  size_t size = size_t( w ) * h * 4;
+  if( !EnsureShmSegment( size ) )
+    return false;
+
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  xcb_shm_get_image_cookie_t imageC = xcb_shm_get_image( xcbConn, mWindow, x, y, w, h,
+      ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, mShmSeg, 0 );
+  CScopedPointer< xcb_shm_get_image_reply_t > imageR( xcb_shm_get_image_reply( xcbConn, imageC, nullptr ) );
+
+  // e.g. window partly off screen, let grabWindow deal with it
+  if( !imageR || ( imageR->depth != 24 && imageR->depth != 32 ) || imageR->size < size )
+    return false;
+
+  // Wraps the segment, no copy
+  QImage shm( mShmData, w, h, w * 4, QImage::Format_RGB32 );
+  return CopyScaled( shm, target );
+}
+
+// Managed windows as maintained by an EWMH window manager
+// Empty if the WM does not support _NET_CLIENT_LIST
+QList< xcb_window_t > LinuxWindowCapture::ListClientWindows() {
   QList< xcb_window_t > windows;
   xcb_connection_t* xcbConn = QX11Info::connection();
-  xcb_query_tree_cookie_t queryC = xcb_query_tree( xcbConn, window );
-  CScopedPointer< xcb_query_tree_reply_t > queryR( xcb_query_tree_reply( xcbConn, queryC, nullptr ) );
-
-  if ( queryR ) {
-    xcb_window_t* children = xcb_query_tree_children( queryR.data() );
-    for( auto c = 0; c < xcb_query_tree_children_length( queryR.data() ); ++c ) {
-      windows << children[ c ];
-      windows << listWindowsRecursive( children[ c ] );
+
+  const char name[] = "_NET_CLIENT_LIST";
+  xcb_intern_atom_cookie_t atomC = xcb_intern_atom( xcbConn, true, sizeof( name ) - 1, name );
+  CScopedPointer< xcb_intern_atom_reply_t > atomR( xcb_intern_atom_reply( xcbConn, atomC, nullptr ) );
+  if( !atomR || atomR->atom == XCB_ATOM_NONE )
+    return windows;
+
+  xcb_get_property_cookie_t propC = xcb_get_property( xcbConn, false, QX11Info::appRootWindow(),
+      atomR->atom, XCB_ATOM_WINDOW, 0, UINT32_MAX );
+  CScopedPointer< xcb_get_property_reply_t > propR( xcb_get_property_reply( xcbConn, propC, nullptr ) );
+  if( !propR || propR->type != XCB_ATOM_WINDOW || propR->format != 32 )
+    return windows;
+
+  xcb_window_t *clients = static_cast< xcb_window_t* >( xcb_get_property_value( propR.data() ) );
+  int numClients = xcb_get_property_value_length( propR.data() ) / sizeof( xcb_window_t );
+  for( int i = 0; i < numClients; i++ ) {
+    windows << clients[ i ];
+  }
+  return windows;
+}
+
+// Walk the window tree level by level
+// All query_tree requests of a level are sent before the first reply is read,
+// so each level costs one round trip instead of one per window
+QList< xcb_window_t > LinuxWindowCapture::ListWindowsTree( xcb_window_t root ) {
+  QList< xcb_window_t > windows;
+  xcb_connection_t* xcbConn = QX11Info::connection();
+
+  QList< xcb_window_t > level;
+  level << root;
+
+  while( !level.isEmpty() ) {
+    QVector< xcb_query_tree_cookie_t > cookies;
+    cookies.reserve( level.size() );
+    foreach( const xcb_window_t& win, level ) {
+      cookies << xcb_query_tree( xcbConn, win );
+    }
+
+    QList< xcb_window_t > nextLevel;
+    foreach( const xcb_query_tree_cookie_t& cookie, cookies ) {
+      CScopedPointer< xcb_query_tree_reply_t > queryR( xcb_query_tree_reply( xcbConn, cookie, nullptr ) );
+      if( !queryR )
+        continue;
+
+      xcb_window_t* children = xcb_query_tree_children( queryR.data() );
+      for( auto c = 0; c < xcb_query_tree_children_length( queryR.data() ); ++c ) {
+        nextLevel << children[ c ];
+      }
     }
+
+    windows << nextLevel;
+    level = nextLevel;
   }
   return windows;
 }
 
 bool LinuxWindowCapture::ExtractWindowProperties( xcb_window_t winId, QRect* winRect, bool* winFocus ) {
+  if( !ExtractWindowGeometry( winId, winRect ) )
+    return false;
+
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  xcb_get_input_focus_cookie_t focusC = xcb_get_input_focus( xcbConn );
+  CScopedPointer < xcb_get_input_focus_reply_t > focusR( xcb_get_input_focus_reply( xcbConn, focusC, nullptr ) );
+  if ( !focusR ) return false;
+
+  *winFocus = ( focusR->focus == winId );
+  return true;
+}
+
+bool LinuxWindowCapture::ExtractWindowGeometry( xcb_window_t winId, QRect* winRect ) {
   if( !winId )
     return false;
 
@@ -90,31 +414,43 @@ bool LinuxWindowCapture::ExtractWindowProperties( xcb_window_t winId, QRect* win
     y = translateR->dst_y;
   }
   winRect->setRect( x, y, geometryR->width, geometryR->height );
-
-  xcb_get_input_focus_cookie_t focusC = xcb_get_input_focus( xcbConn );
-  CScopedPointer < xcb_get_input_focus_reply_t > focusR( xcb_get_input_focus_reply( xcbConn, focusC, nullptr ) );
-  if ( !focusR ) return false;
-
-  *winFocus = ( focusR->focus == winId );
   return true;
 }
 
 xcb_window_t LinuxWindowCapture::FindWindow( const QString& instanceName, const QString& windowClass ) {
+  xcb_window_t winID = FindWindowIn( ListClientWindows(), instanceName, windowClass );
+
+  // Not every WM lists all windows there (or maintains the list at all)
+  if( winID == XCB_WINDOW_NONE )
+    winID = FindWindowIn( ListWindowsTree( QX11Info::appRootWindow() ), instanceName, windowClass );
+
+  return winID;
+}
+
+xcb_window_t LinuxWindowCapture::FindWindowIn( const QList< xcb_window_t >& windows, const QString& instanceName, const QString& windowClass ) {
   xcb_window_t winID = XCB_WINDOW_NONE;
-  QList< xcb_window_t > windows = listWindowsRecursive( QX11Info::appRootWindow() );
   xcb_connection_t* xcbConn = QX11Info::connection();
 
+  // Send all requests first, then collect the replies
+  QVector< xcb_get_property_cookie_t > cookies;
+  cookies.reserve( windows.size() );
   foreach( const xcb_window_t& win, windows ) {
+    cookies << xcb_icccm_get_wm_class( xcbConn, win );
+  }
 
-    xcb_icccm_get_wm_class_reply_t wmNameR;
-    xcb_get_property_cookie_t wmClassC = xcb_icccm_get_wm_class( xcbConn, win );
+  for( int i = 0; i < cookies.size(); i++ ) {
+    if( winID != XCB_WINDOW_NONE ) {
+      xcb_discard_reply( xcbConn, cookies[ i ].sequence );
+      continue;
+    }
 
-    if ( xcb_icccm_get_wm_class_reply( xcbConn, wmClassC, &wmNameR, nullptr ) ) {
+    xcb_icccm_get_wm_class_reply_t wmNameR;
+    if ( xcb_icccm_get_wm_class_reply( xcbConn, cookies[ i ], &wmNameR, nullptr ) ) {
       if( !qstricmp( wmNameR.class_name, qt2cstr( windowClass ) ) ||
-          !qstricmp( wmNameR.instance_name, qt2cstr ( instanceName ) ) ) {
-        winID = win;
-        break;
+          !qstricmp( wmNameR.instance_name, qt2cstr( instanceName ) ) ) {
+        winID = windows[ i ];
       }
+      xcb_icccm_get_wm_class_reply_wipe( &wmNameR );
     }
   }
   return winID;
@@ -123,3 +459,7 @@ xcb_window_t LinuxWindowCapture::FindWindow( const QString& instanceName, const
 bool LinuxWindowCapture::HasFocus() {
   return mFocus;
 }
+
+bool LinuxWindowCapture::ReportsWindowChanges() {
+  return mEventsAvailable;
+}
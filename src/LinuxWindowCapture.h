@@ -2,10 +2,13 @@
 #define LINUXWINDOWCAPTURE_H
 
 #include "WindowCapture.h"
+#include "LinuxProcessFinder.h"
 #include <xcb/xcb.h>
+#include <xcb/shm.h>
 #include <QScopedPointer>
+#include <QAbstractNativeEventFilter>
 
-class LinuxWindowCapture : public QObject, public WindowCapture
+class LinuxWindowCapture : public QObject, public WindowCapture, public QAbstractNativeEventFilter
 {
 Q_OBJECT
 
@@ -14,13 +17,45 @@ private:
   QRect   mRect;
   bool mFocus;
 
-  static xcb_window_t FindWindow( const QString& wmName, const QString& wmClass );
-  static QList< xcb_window_t > listWindowsRecursive( const xcb_window_t& window );
+  // Only look for the window once the game process exists
+  LinuxProcessFinder mProcessFinder;
+  bool mProcessRunning;
+
+  // Once the game window is found, geometry and focus are kept up to date
+  // from X events instead of querying the server on every update
+  bool mEventsAvailable;
+  bool mTracking;
+  xcb_atom_t mActiveWindowAtom;
+
+  void TrackWindow();
+  void RefreshGeometry();
+  void RefreshFocus();
+  void WindowLost();
+
+  // MIT-SHM segment reused for all captures, grown for the largest one
+  bool          mShmAvailable;
+  xcb_shm_seg_t mShmSeg;
+  int           mShmId;
+  uchar        *mShmData;
+  size_t        mShmSize;
+
+  bool EnsureShmSegment( size_t size );
+  void ReleaseShmSegment();
+  bool CaptureShm( int x, int y, int w, int h, QImage *target );
+
+  static QList< xcb_window_t > ListClientWindows();
+  static QList< xcb_window_t > ListWindowsTree( xcb_window_t root );
+  static xcb_window_t FindWindowIn( const QList< xcb_window_t >& windows, const QString& instanceName, const QString& windowClass );
   static bool ExtractWindowProperties( xcb_window_t winId, QRect *winRect, bool *focus );
+  static bool ExtractWindowGeometry( xcb_window_t winId, QRect *winRect );
+  static void SelectEvents( xcb_window_t winId, uint32_t mask );
 
 public:
   LinuxWindowCapture();
 
+  static xcb_window_t FindWindow( const QString& wmName, const QString& wmClass );
+  ~LinuxWindowCapture();
+
   bool WindowFound();
   int Width();
   int Height();
@@ -29,7 +64,16 @@ public:
   int Top();
 
   QPixmap Capture( int x, int y, int w, int h );
+  QImage CaptureImage( int x, int y, int w, int h );
+  bool CaptureInto( int x, int y, int w, int h, QImage *target );
   bool HasFocus();
+  bool ReportsWindowChanges();
+
+  bool nativeEventFilter( const QByteArray& eventType, void *message, long *result );
+
+signals:
+  // Game window moved, resized, gained or lost focus or went away
+  void WindowChanged();
 };
 
 template< typename T > using CScopedPointer = QScopedPointer< T, QScopedPointerPodDeleter >;
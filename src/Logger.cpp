@@ -3,6 +3,7 @@
 
 #include <QTime>
 #include <QTextStream>
+#include <QThread>
 #include <cassert>
 
 DEFINE_SINGLETON_SCOPE( Logger );
@@ -38,7 +39,13 @@ void Logger::ProcessMessages() {
   if( !mProcessMessages )
     return;
 
-  for( auto it : mQueue ) {
+  QList< QPair< LogEventType, QString > > queue;
+  {
+    QMutexLocker lock( &mQueueMutex );
+    queue.swap( mQueue );
+  }
+
+  for( auto it : queue ) {
     LogEventType type = it.first;
     const QString& msg = it.second;
 
@@ -50,8 +57,6 @@ void Logger::ProcessMessages() {
 
     emit NewMessage( type, msg );
   }
-
-  mQueue.clear();
 }
 
 void Logger::Add( LogEventType type, const char *fmt, ... ) {
@@ -70,6 +75,15 @@ void Logger::Add( LogEventType type, const char *fmt, ... ) {
   QString timestamp = QTime::currentTime().toString( "hh:mm:ss" );
   QString line = QString( "[%1] %2: %3\n" ).arg( timestamp ).arg( LOG_EVENT_TYPE_NAMES[ type ] ).arg( buffer );
 
-  mQueue.push_back( QPair< LogEventType, QString >( type, line ) );
-  ProcessMessages();
+  {
+    QMutexLocker lock( &mQueueMutex );
+    mQueue.push_back( QPair< LogEventType, QString >( type, line ) );
+  }
+
+  // File and UI are only touched from the logger's own thread
+  if( QThread::currentThread() == thread() ) {
+    ProcessMessages();
+  } else {
+    QMetaObject::invokeMethod( this, "ProcessMessages", Qt::QueuedConnection );
+  }
 }
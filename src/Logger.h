@@ -5,6 +5,7 @@
 #include <QFile>
 #include <QString>
 #include <QPair>
+#include <QMutex>
 
 typedef enum {
   LOG_DEBUG = 0,
@@ -25,9 +26,11 @@ DEFINE_SINGLETON( Logger );
 
 private:
   QList< QPair< LogEventType, QString > > mQueue;
+  QMutex mQueueMutex; // messages can be added from worker threads
   QFile *mFile;
   bool mProcessMessages; // delay first messages until StartProcessing()
 
+private slots:
   void ProcessMessages();
 
 public:
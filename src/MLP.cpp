@@ -3,70 +3,448 @@
 #include <math.h>
 
 #include <cassert>
+#include <cstring>
 #include <numeric>
 #include <algorithm>
 
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#define MLP_USE_AVX
+#define MLP_USE_AVX2
+#elif defined( __AVX__ )
+#include <immintrin.h>
+#define MLP_USE_AVX
+#define MLP_USE_SSSE3
+#elif defined( __SSSE3__ )
+#include <tmmintrin.h>
+#define MLP_USE_SSE
+#define MLP_USE_SSSE3
+#elif defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#include <emmintrin.h>
+#define MLP_USE_SSE
+#endif
+
 namespace MLP
 {
-  MultiLayerPerceptron::MultiLayerPerceptron() {
+  MultiLayerPerceptron::MultiLayerPerceptron()
+    : mQuantized( false )
+  {
+  }
+
+  int MultiLayerPerceptron::PaddedSize( int size, int padding ) {
+    return ( ( size + padding - 1 ) / padding ) * padding;
+  }
+
+  // a and b have to be aligned to MLP_ALIGNMENT
+  // n has to be a multiple of MLP_ROW_PADDING
+  float MultiLayerPerceptron::Dot( const float *a, const float *b, int n ) {
+    assert( n % MLP_ROW_PADDING == 0 );
+
+#if defined( MLP_USE_AVX )
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for( ; i + 16 <= n; i += 16 ) {
+      sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( _mm256_load_ps( a + i ), _mm256_load_ps( b + i ) ) );
+      sum1 = _mm256_add_ps( sum1, _mm256_mul_ps( _mm256_load_ps( a + i + 8 ), _mm256_load_ps( b + i + 8 ) ) );
+    }
+    if( i < n ) {
+      sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( _mm256_load_ps( a + i ), _mm256_load_ps( b + i ) ) );
+    }
+    __m256 sum = _mm256_add_ps( sum0, sum1 );
+    __m128 lo = _mm256_castps256_ps128( sum );
+    __m128 hi = _mm256_extractf128_ps( sum, 1 );
+    __m128 r = _mm_add_ps( lo, hi );
+    r = _mm_add_ps( r, _mm_movehl_ps( r, r ) );
+    r = _mm_add_ss( r, _mm_shuffle_ps( r, r, 1 ) );
+    return _mm_cvtss_f32( r );
+#elif defined( MLP_USE_SSE )
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    for( int i = 0; i < n; i += 8 ) {
+      sum0 = _mm_add_ps( sum0, _mm_mul_ps( _mm_load_ps( a + i ), _mm_load_ps( b + i ) ) );
+      sum1 = _mm_add_ps( sum1, _mm_mul_ps( _mm_load_ps( a + i + 4 ), _mm_load_ps( b + i + 4 ) ) );
+    }
+    __m128 r = _mm_add_ps( sum0, sum1 );
+    r = _mm_add_ps( r, _mm_movehl_ps( r, r ) );
+    r = _mm_add_ss( r, _mm_shuffle_ps( r, r, 1 ) );
+    return _mm_cvtss_f32( r );
+#else
+    return std::inner_product( a, a + n, b, 0.0f );
+#endif
+  }
+
+  // Dot products of one weight row with 4 consecutive inputs (xStride apart)
+  // so each weight load is used 4 times
+  static void Dot4( const float *w, const float *x, int xStride, int n, float *out ) {
+    assert( n % MLP_ROW_PADDING == 0 );
+
+    const float *x0 = x;
+    const float *x1 = x + xStride;
+    const float *x2 = x + 2 * xStride;
+    const float *x3 = x + 3 * xStride;
+
+#if defined( MLP_USE_AVX )
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    for( int i = 0; i < n; i += 8 ) {
+      __m256 vw = _mm256_load_ps( w + i );
+      s0 = _mm256_add_ps( s0, _mm256_mul_ps( vw, _mm256_load_ps( x0 + i ) ) );
+      s1 = _mm256_add_ps( s1, _mm256_mul_ps( vw, _mm256_load_ps( x1 + i ) ) );
+      s2 = _mm256_add_ps( s2, _mm256_mul_ps( vw, _mm256_load_ps( x2 + i ) ) );
+      s3 = _mm256_add_ps( s3, _mm256_mul_ps( vw, _mm256_load_ps( x3 + i ) ) );
+    }
+    // horizontal sums of all four at once
+    __m256 t0 = _mm256_hadd_ps( s0, s1 );
+    __m256 t1 = _mm256_hadd_ps( s2, s3 );
+    __m256 t = _mm256_hadd_ps( t0, t1 );
+    __m128 r = _mm_add_ps( _mm256_castps256_ps128( t ), _mm256_extractf128_ps( t, 1 ) );
+    _mm_storeu_ps( out, r );
+#elif defined( MLP_USE_SSE )
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+    for( int i = 0; i < n; i += 4 ) {
+      __m128 vw = _mm_load_ps( w + i );
+      s0 = _mm_add_ps( s0, _mm_mul_ps( vw, _mm_load_ps( x0 + i ) ) );
+      s1 = _mm_add_ps( s1, _mm_mul_ps( vw, _mm_load_ps( x1 + i ) ) );
+      s2 = _mm_add_ps( s2, _mm_mul_ps( vw, _mm_load_ps( x2 + i ) ) );
+      s3 = _mm_add_ps( s3, _mm_mul_ps( vw, _mm_load_ps( x3 + i ) ) );
+    }
+    // transpose, then add the rows to get the four sums
+    _MM_TRANSPOSE4_PS( s0, s1, s2, s3 );
+    _mm_storeu_ps( out, _mm_add_ps( _mm_add_ps( s0, s1 ), _mm_add_ps( s2, s3 ) ) );
+#else
+    out[ 0 ] = std::inner_product( w, w + n, x0, 0.0f );
+    out[ 1 ] = std::inner_product( w, w + n, x1, 0.0f );
+    out[ 2 ] = std::inner_product( w, w + n, x2, 0.0f );
+    out[ 3 ] = std::inner_product( w, w + n, x3, 0.0f );
+#endif
+  }
+
+  // weights and input have to be aligned to MLP_ALIGNMENT
+  // n has to be a multiple of MLP_QUANTIZED_ROW_PADDING
+  // input values have to be within [0, 127] so the pairwise
+  // u8 * s8 sums of maddubs can not saturate
+  int32_t MultiLayerPerceptron::DotQuantized( const int8_t *weights, const uint8_t *input, int n ) {
+    assert( n % MLP_QUANTIZED_ROW_PADDING == 0 );
+
+#if defined( MLP_USE_AVX2 )
+    const __m256i ones = _mm256_set1_epi16( 1 );
+    __m256i sum = _mm256_setzero_si256();
+    for( int i = 0; i < n; i += 32 ) {
+      __m256i w = _mm256_load_si256( reinterpret_cast< const __m256i* >( weights + i ) );
+      __m256i x = _mm256_load_si256( reinterpret_cast< const __m256i* >( input + i ) );
+      sum = _mm256_add_epi32( sum, _mm256_madd_epi16( _mm256_maddubs_epi16( x, w ), ones ) );
+    }
+    __m128i r = _mm_add_epi32( _mm256_castsi256_si128( sum ), _mm256_extracti128_si256( sum, 1 ) );
+    r = _mm_add_epi32( r, _mm_shuffle_epi32( r, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    r = _mm_add_epi32( r, _mm_shuffle_epi32( r, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_cvtsi128_si32( r );
+#elif defined( MLP_USE_SSSE3 )
+    const __m128i ones = _mm_set1_epi16( 1 );
+    __m128i sum = _mm_setzero_si128();
+    for( int i = 0; i < n; i += 16 ) {
+      __m128i w = _mm_load_si128( reinterpret_cast< const __m128i* >( weights + i ) );
+      __m128i x = _mm_load_si128( reinterpret_cast< const __m128i* >( input + i ) );
+      sum = _mm_add_epi32( sum, _mm_madd_epi16( _mm_maddubs_epi16( x, w ), ones ) );
+    }
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_cvtsi128_si32( sum );
+#elif defined( MLP_USE_SSE )
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    for( int i = 0; i < n; i += 16 ) {
+      __m128i w = _mm_load_si128( reinterpret_cast< const __m128i* >( weights + i ) );
+      __m128i x = _mm_load_si128( reinterpret_cast< const __m128i* >( input + i ) );
+
+      // SSE2 has no sign extension, so unpack into the high byte and shift back
+      __m128i wLo = _mm_srai_epi16( _mm_unpacklo_epi8( w, w ), 8 );
+      __m128i wHi = _mm_srai_epi16( _mm_unpackhi_epi8( w, w ), 8 );
+      __m128i xLo = _mm_unpacklo_epi8( x, zero );
+      __m128i xHi = _mm_unpackhi_epi8( x, zero );
+      sum = _mm_add_epi32( sum, _mm_madd_epi16( wLo, xLo ) );
+      sum = _mm_add_epi32( sum, _mm_madd_epi16( wHi, xHi ) );
+    }
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_cvtsi128_si32( sum );
+#else
+    int32_t sum = 0;
+    for( int i = 0; i < n; i++ ) {
+      sum += int32_t( weights[ i ] ) * int32_t( input[ i ] );
+    }
+    return sum;
+#endif
+  }
+
+  // Symmetric quantization to [-127, 127]
+  // Returns the scale to get back to the original values
+  static float QuantizeRow( const float *values, int n, int8_t *out ) {
+    float maxAbs = 0.0f;
+    for( int i = 0; i < n; i++ ) {
+      maxAbs = std::max( maxAbs, fabsf( values[ i ] ) );
+    }
+
+    float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    for( int i = 0; i < n; i++ ) {
+      out[ i ] = ( int8_t )lrintf( values[ i ] / scale );
+    }
+    return scale;
+  }
+
+  // Inputs of a layer are never negative (binary image or
+  // sigmoid/rectifier/softmax activations), so map [0, max] to [0, 127]
+  static float QuantizeInput( const float *values, int n, uint8_t *out ) {
+    float maxValue = 0.0f;
+    for( int i = 0; i < n; i++ ) {
+      assert( values[ i ] >= 0.0f );
+      maxValue = std::max( maxValue, values[ i ] );
+    }
+
+    float scale = maxValue > 0.0f ? maxValue / 127.0f : 1.0f;
+    float invScale = 1.0f / scale;
+    for( int i = 0; i < n; i++ ) {
+      out[ i ] = ( uint8_t )( values[ i ] * invScale + 0.5f );
+    }
+    return scale;
   }
 
   void MultiLayerPerceptron::AddLayer( const Layer& layer ) {
+    int numOutputs = layer.biases.size();
+    assert( (int)layer.weights.size() == numOutputs );
+    int numInputs = numOutputs ? layer.weights.front().size() : 0;
+
+    Vector weights;
+    weights.reserve( numInputs * numOutputs );
+    for( const Vector& row : layer.weights ) {
+      assert( (int)row.size() == numInputs );
+      weights.insert( weights.end(), row.begin(), row.end() );
+    }
+
+    AddLayer( layer.type, numInputs, numOutputs, layer.biases.data(), weights.data() );
+  }
+
+  void MultiLayerPerceptron::AddLayer( LayerType type, int numInputs, int numOutputs, const float *biases, const float *weights ) {
+    assert( mLayers.empty() || mLayers.back().numOutputs == numInputs );
+    assert( !mQuantized );
+
+    DenseLayer layer;
+    layer.type = type;
+    layer.numInputs = numInputs;
+    layer.numOutputs = numOutputs;
+    layer.stride = PaddedSize( numInputs );
+    layer.quantizedStride = 0;
+    layer.biases.resize( numOutputs );
+    memcpy( layer.biases.data(), biases, numOutputs * sizeof( float ) );
+    layer.weights.assign( layer.stride * numOutputs, 0.0f );
+
+    // weights may point straight into a mapped model file
+    // which gives no alignment guarantees, so memcpy row by row
+    for( int i = 0; i < numOutputs; i++ ) {
+      memcpy( layer.weights.data() + i * layer.stride, weights + i * numInputs, numInputs * sizeof( float ) );
+    }
+
     mLayers.push_back( layer );
   }
 
-  Vector MultiLayerPerceptron::FeedForward( const Vector& input, const Layer& layer ) const {
-    int numNodes = layer.biases.size();
+  // input is padded to layer.stride, output will be padded to the
+  // stride of the next layer (zeros beyond numOutputs)
+  void MultiLayerPerceptron::FeedForward( const AlignedVector& input, const DenseLayer& layer, AlignedVector *output ) const {
+    int numNodes = layer.numOutputs;
 
-    Vector z( numNodes );
-    for( int i = 0; i < numNodes; i++ ) {
-      const Vector& weights = layer.weights[ i ];
-      float bias = layer.biases[ i ];
+    assert( (int)input.size() == layer.stride );
+    output->assign( PaddedSize( numNodes ), 0.0f );
+    float *z = output->data();
 
-      assert( weights.size() == input.size() );
+    for( int i = 0; i < numNodes; i++ ) {
+      const float *weights = layer.weights.data() + i * layer.stride;
 
       // z = wT * x + b
-      z[ i ] = std::inner_product( weights.begin(), weights.end(), input.begin(), bias );
+      z[ i ] = Dot( weights, input.data(), layer.stride ) + layer.biases[ i ];
+    }
+
+    Activate( layer.type, z, numNodes );
+  }
+
+  // The input is quantized on the fly with a single scale
+  void MultiLayerPerceptron::FeedForwardQuantized( const AlignedVector& input, const DenseLayer& layer, AlignedVector *output ) const {
+    int numNodes = layer.numOutputs;
+
+    AlignedQuantizedInputVector quantizedInput( layer.quantizedStride, 0 );
+    float inputScale = QuantizeInput( input.data(), layer.numInputs, quantizedInput.data() );
+
+    output->assign( PaddedSize( numNodes ), 0.0f );
+    float *z = output->data();
+
+    for( int i = 0; i < numNodes; i++ ) {
+      const int8_t *weights = layer.quantizedWeights.data() + i * layer.quantizedStride;
+      int32_t dot = DotQuantized( weights, quantizedInput.data(), layer.quantizedStride );
+
+      z[ i ] = dot * layer.scales[ i ] * inputScale + layer.biases[ i ];
+    }
+
+    Activate( layer.type, z, numNodes );
+  }
+
+  // inputs holds batchSize rows padded to layer.stride, outputs
+  // will hold batchSize rows padded to the stride of the next layer
+  void MultiLayerPerceptron::FeedForwardBatch( const AlignedVector& inputs, int batchSize, const DenseLayer& layer, AlignedVector *outputs ) const {
+    int numNodes = layer.numOutputs;
+    int outputStride = PaddedSize( numNodes );
+
+    assert( (int)inputs.size() == layer.stride * batchSize );
+    outputs->assign( outputStride * batchSize, 0.0f );
+    float *z = outputs->data();
+
+    if( mQuantized ) {
+      AlignedQuantizedInputVector quantizedInputs( layer.quantizedStride * batchSize, 0 );
+      Vector inputScales( batchSize );
+      for( int b = 0; b < batchSize; b++ ) {
+        inputScales[ b ] = QuantizeInput( inputs.data() + b * layer.stride, layer.numInputs,
+            quantizedInputs.data() + b * layer.quantizedStride );
+      }
+
+      for( int i = 0; i < numNodes; i++ ) {
+        const int8_t *weights = layer.quantizedWeights.data() + i * layer.quantizedStride;
+        for( int b = 0; b < batchSize; b++ ) {
+          int32_t dot = DotQuantized( weights, quantizedInputs.data() + b * layer.quantizedStride, layer.quantizedStride );
+          z[ b * outputStride + i ] = dot * layer.scales[ i ] * inputScales[ b ] + layer.biases[ i ];
+        }
+      }
+    } else {
+      for( int i = 0; i < numNodes; i++ ) {
+        const float *weights = layer.weights.data() + i * layer.stride;
+
+        int b = 0;
+        for( ; b + 4 <= batchSize; b += 4 ) {
+          float dots[ 4 ];
+          Dot4( weights, inputs.data() + b * layer.stride, layer.stride, layer.stride, dots );
+          for( int k = 0; k < 4; k++ ) {
+            z[ ( b + k ) * outputStride + i ] = dots[ k ] + layer.biases[ i ];
+          }
+        }
+        for( ; b < batchSize; b++ ) {
+          z[ b * outputStride + i ] = Dot( weights, inputs.data() + b * layer.stride, layer.stride ) + layer.biases[ i ];
+        }
+      }
+    }
+
+    for( int b = 0; b < batchSize; b++ ) {
+      Activate( layer.type, z + b * outputStride, numNodes );
     }
+  }
 
-    Vector output( numNodes );
-    if( layer.type == LAYER_SIGMOID ) {
+  void MultiLayerPerceptron::Activate( LayerType type, float *z, int numNodes ) {
+    if( type == LAYER_SIGMOID ) {
       for( int i = 0; i < numNodes; i++ ) {
-        output[ i ] = 1.0f / ( 1.0f + expf( -z[ i ] ) );
+        z[ i ] = 1.0f / ( 1.0f + expf( -z[ i ] ) );
       }
-    } else if( layer.type == LAYER_RECTIFIER ) {
+    } else if( type == LAYER_RECTIFIER ) {
       for( int i = 0; i < numNodes; i++ ) {
-        output[ i ] = std::max( 0.0f, z[ i ] );
+        z[ i ] = std::max( 0.0f, z[ i ] );
       }
-    } else if( layer.type == LAYER_SOFTMAX ) {
+    } else if( type == LAYER_SOFTMAX ) {
       // Use the log-sum trick to compute the exponential sum
       // oi = exp(zi) / sum_j { exp(zj) }
       // log oi = zi - log( sum_j { exp(zj) } )
       // log oi = zi - log( sum_j { exp(zj) - m + m } )
       // log oi = zi - m - log( sum_j { exp(zj) - m } )
-      float m = *std::max_element( z.begin(), z.end() );
+      float m = *std::max_element( z, z + numNodes );
       float logSum = logf(
-        std::accumulate( z.begin(), z.end(), 0.0f, [m]( float sum, float zj ) {
+        std::accumulate( z, z + numNodes, 0.0f, [m]( float sum, float zj ) {
           return sum + expf( zj - m );
         })
       );
 
       for( int i = 0; i < numNodes; i++ ) {
-        output[ i ] = expf( z[ i ] - m - logSum );
+        z[ i ] = expf( z[ i ] - m - logSum );
       }
     }
+  }
+
+  void MultiLayerPerceptron::Quantize() {
+    if( mQuantized )
+      return;
 
-    return output;
+    for( DenseLayer& layer : mLayers ) {
+      layer.quantizedStride = PaddedSize( layer.numInputs, MLP_QUANTIZED_ROW_PADDING );
+      layer.quantizedWeights.assign( layer.quantizedStride * layer.numOutputs, 0 );
+      layer.scales.resize( layer.numOutputs );
+
+      for( int i = 0; i < layer.numOutputs; i++ ) {
+        layer.scales[ i ] = QuantizeRow( layer.weights.data() + i * layer.stride, layer.numInputs,
+            layer.quantizedWeights.data() + i * layer.quantizedStride );
+      }
+
+      // fp32 weights are not needed anymore
+      AlignedVector().swap( layer.weights );
+    }
+
+    mQuantized = true;
+  }
+
+  bool MultiLayerPerceptron::Quantized() const {
+    return mQuantized;
+  }
+
+  // Bytes occupied by the parameters of all layers
+  size_t MultiLayerPerceptron::WeightsSize() const {
+    size_t size = 0;
+    for( const DenseLayer& layer : mLayers ) {
+      size += layer.biases.size() * sizeof( float );
+      size += layer.weights.size() * sizeof( float );
+      size += layer.scales.size() * sizeof( float );
+      size += layer.quantizedWeights.size() * sizeof( int8_t );
+    }
+    return size;
   }
 
   Vector MultiLayerPerceptron::Compute( const Vector& input ) const {
-    Vector res = input;
+    assert( mLayers.size() );
+    assert( (int)input.size() == mLayers.front().numInputs );
+
+    AlignedVector res( mLayers.front().stride, 0.0f );
+    std::copy( input.begin(), input.end(), res.begin() );
 
+    AlignedVector next;
+    for( const DenseLayer& layer : mLayers ) {
+      if( mQuantized ) {
+        FeedForwardQuantized( res, layer, &next );
+      } else {
+        FeedForward( res, layer, &next );
+      }
+      res.swap( next );
+    }
+
+    return Vector( res.begin(), res.begin() + mLayers.back().numOutputs );
+  }
+
+  Matrix MultiLayerPerceptron::ComputeBatch( const Matrix& inputs ) const {
     assert( mLayers.size() );
-    for( const Layer& layer : mLayers ) {
-      res = FeedForward( res, layer );
+
+    int batchSize = inputs.size();
+    int stride = mLayers.front().stride;
+
+    AlignedVector res( stride * batchSize, 0.0f );
+    for( int b = 0; b < batchSize; b++ ) {
+      assert( (int)inputs[ b ].size() == mLayers.front().numInputs );
+      std::copy( inputs[ b ].begin(), inputs[ b ].end(), res.begin() + b * stride );
+    }
+
+    AlignedVector next;
+    for( const DenseLayer& layer : mLayers ) {
+      FeedForwardBatch( res, batchSize, layer, &next );
+      res.swap( next );
     }
 
-    return res;
+    int numOutputs = mLayers.back().numOutputs;
+    int outputStride = PaddedSize( numOutputs );
+
+    Matrix outputs( batchSize );
+    for( int b = 0; b < batchSize; b++ ) {
+      outputs[ b ].assign( res.begin() + b * outputStride, res.begin() + b * outputStride + numOutputs );
+    }
+    return outputs;
   }
 }
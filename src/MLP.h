@@ -1,11 +1,69 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Alignment of the weight rows, enough for AVX loads
+#define MLP_ALIGNMENT 32
+
+// Rows are padded to a multiple of this many floats (zero filled)
+// so the SIMD kernels never need to handle a remainder
+#define MLP_ROW_PADDING 8
+
+// Same for the int8 rows of quantized layers
+#define MLP_QUANTIZED_ROW_PADDING 32
 
 namespace MLP
 {
+  template< typename T >
+  class AlignedAllocator {
+  public:
+    typedef T value_type;
+
+    template< typename U > struct rebind { typedef AlignedAllocator< U > other; };
+
+    AlignedAllocator() {}
+    template< typename U > AlignedAllocator( const AlignedAllocator< U >& ) {}
+
+    T* allocate( std::size_t n ) {
+      void *ptr = NULL;
+#ifdef _MSC_VER
+      ptr = _aligned_malloc( n * sizeof( T ), MLP_ALIGNMENT );
+#else
+      if( posix_memalign( &ptr, MLP_ALIGNMENT, n * sizeof( T ) ) != 0 ) {
+        ptr = NULL;
+      }
+#endif
+      if( !ptr ) {
+        throw std::bad_alloc();
+      }
+      return static_cast< T* >( ptr );
+    }
+
+    void deallocate( T *ptr, std::size_t ) {
+#ifdef _MSC_VER
+      _aligned_free( ptr );
+#else
+      free( ptr );
+#endif
+    }
+
+    template< typename U > bool operator==( const AlignedAllocator< U >& ) const { return true; }
+    template< typename U > bool operator!=( const AlignedAllocator< U >& ) const { return false; }
+  };
+
   typedef std::vector< float > Vector;
   typedef std::vector< Vector > Matrix;
+  typedef std::vector< float, AlignedAllocator< float > > AlignedVector;
+  typedef std::vector< int8_t, AlignedAllocator< int8_t > > AlignedQuantizedVector;
+  typedef std::vector< uint8_t, AlignedAllocator< uint8_t > > AlignedQuantizedInputVector;
 
   typedef enum {
     LAYER_SIGMOID,
@@ -19,18 +77,54 @@ namespace MLP
     Matrix      weights;
   } Layer;
 
+  // Weights of a layer stored as one row-major buffer
+  // Each row is padded with zeros to stride floats
+  // Quantized layers keep int8 rows (padded to quantizedStride)
+  // with one scale per row instead
+  typedef struct {
+    LayerType     type;
+    int           numInputs;
+    int           numOutputs;
+    int           stride;
+    Vector        biases;
+    AlignedVector weights;
+
+    int                     quantizedStride;
+    Vector                  scales;
+    AlignedQuantizedVector  quantizedWeights;
+  } DenseLayer;
+
   // Simple feed forward Artificial Neural Network
   // Only for prediction, using pretrained parameters
   class MultiLayerPerceptron {
   private:
-    std::vector< Layer > mLayers;
+    std::vector< DenseLayer > mLayers;
+    bool mQuantized;
 
-    Vector FeedForward( const Vector& input, const Layer& layer ) const;
+    void FeedForward( const AlignedVector& input, const DenseLayer& layer, AlignedVector *output ) const;
+    void FeedForwardQuantized( const AlignedVector& input, const DenseLayer& layer, AlignedVector *output ) const;
+    void FeedForwardBatch( const AlignedVector& inputs, int batchSize, const DenseLayer& layer, AlignedVector *outputs ) const;
+    static void Activate( LayerType type, float *z, int numNodes );
 
   public:
     MultiLayerPerceptron();
     void AddLayer( const Layer& layer );
+    void AddLayer( LayerType type, int numInputs, int numOutputs, const float *biases, const float *weights );
+
+    // Replace the fp32 weights with int8 weights and per-row scales
+    // Less memory and faster, at the cost of some precision
+    void Quantize();
+    bool Quantized() const;
 
     Vector Compute( const Vector& input ) const;
+
+    // Several inputs at once, every weight row is loaded once per batch
+    // instead of once per input
+    Matrix ComputeBatch( const Matrix& inputs ) const;
+    size_t WeightsSize() const;
+
+    static int PaddedSize( int size, int padding = MLP_ROW_PADDING );
+    static float Dot( const float *a, const float *b, int n );
+    static int32_t DotQuantized( const int8_t *weights, const uint8_t *input, int n );
   };
 }
@@ -0,0 +1,489 @@
+#include "ParquetWriter.h"
+
+#include <algorithm>
+#include <cassert>
+
+#define PARQUET_MAGIC "PAR1"
+#define PARQUET_CREATED_BY "Track-o-Bot"
+
+// Parquet enums (parquet.thrift)
+#define PARQUET_TYPE_BOOLEAN 0
+#define PARQUET_TYPE_INT32 1
+#define PARQUET_TYPE_INT64 2
+#define PARQUET_TYPE_BYTE_ARRAY 6
+
+#define PARQUET_CONVERTED_UTF8 0
+#define PARQUET_CONVERTED_TIMESTAMP_MILLIS 9
+
+#define PARQUET_ENCODING_PLAIN 0
+#define PARQUET_ENCODING_RLE 3
+#define PARQUET_ENCODING_DELTA_BINARY_PACKED 5
+#define PARQUET_ENCODING_RLE_DICTIONARY 8
+
+#define PARQUET_PAGE_DATA 0
+#define PARQUET_PAGE_DICTIONARY 2
+
+#define PARQUET_CODEC_UNCOMPRESSED 0
+
+// DELTA_BINARY_PACKED layout: blocks of 128 values in 4 miniblocks of 32
+#define PARQUET_DELTA_BLOCK_SIZE 128
+#define PARQUET_DELTA_MINIBLOCKS 4
+#define PARQUET_DELTA_MINIBLOCK_SIZE ( PARQUET_DELTA_BLOCK_SIZE / PARQUET_DELTA_MINIBLOCKS )
+
+// Thrift compact protocol, just enough for the Parquet metadata
+namespace {
+  enum {
+    THRIFT_BOOL_TRUE = 1,
+    THRIFT_BOOL_FALSE = 2,
+    THRIFT_I32 = 5,
+    THRIFT_I64 = 6,
+    THRIFT_BINARY = 8,
+    THRIFT_LIST = 9,
+    THRIFT_STRUCT = 12
+  };
+
+  void PutVarint( std::string& out, uint64_t value ) {
+    while( value >= 0x80 ) {
+      out += char( ( value & 0x7F ) | 0x80 );
+      value >>= 7;
+    }
+    out += char( value );
+  }
+
+  uint64_t ZigZag( int64_t value ) {
+    return ( uint64_t( value ) << 1 ) ^ uint64_t( value >> 63 );
+  }
+
+  void PutLittleEndian( std::string& out, uint64_t value, int bytes ) {
+    for( int i = 0; i < bytes; i++ ) {
+      out += char( ( value >> ( 8 * i ) ) & 0xFF );
+    }
+  }
+
+  // Values packed LSB first with the given bit width, as Parquet's bit-packing does
+  void PutBitPacked( std::string& out, const uint64_t *values, size_t count, int bitWidth ) {
+    size_t start = out.size();
+    out.append( ( count * bitWidth + 7 ) / 8, 0 );
+
+    size_t bit = 0;
+    for( size_t i = 0; i < count; i++ ) {
+      for( int b = 0; b < bitWidth; b++, bit++ ) {
+        if( ( values[ i ] >> b ) & 1 ) {
+          out[ start + bit / 8 ] |= char( 1 << ( bit % 8 ) );
+        }
+      }
+    }
+  }
+
+  int BitWidth( uint64_t value ) {
+    int width = 0;
+    while( value ) {
+      width++;
+      value >>= 1;
+    }
+    return width;
+  }
+
+  class ThriftWriter {
+  private:
+    std::string mOut;
+    std::vector< int > mLastField;
+
+    void FieldHeader( int id, int type ) {
+      int delta = id - mLastField.back();
+      if( delta > 0 && delta <= 15 ) {
+        mOut += char( ( delta << 4 ) | type );
+      } else {
+        mOut += char( type );
+        PutVarint( mOut, ZigZag( id ) );
+      }
+      mLastField.back() = id;
+    }
+
+  public:
+    ThriftWriter() { mLastField.push_back( 0 ); }
+
+    const std::string& Data() const { return mOut; }
+
+    void I32( int id, int32_t value ) {
+      FieldHeader( id, THRIFT_I32 );
+      PutVarint( mOut, ZigZag( value ) );
+    }
+
+    void I64( int id, int64_t value ) {
+      FieldHeader( id, THRIFT_I64 );
+      PutVarint( mOut, ZigZag( value ) );
+    }
+
+
+    void String( int id, const std::string& value ) {
+      FieldHeader( id, THRIFT_BINARY );
+      PutVarint( mOut, value.size() );
+      mOut += value;
+    }
+
+    void BeginStruct( int id ) {
+      FieldHeader( id, THRIFT_STRUCT );
+      mLastField.push_back( 0 );
+    }
+
+    void EndStruct() {
+      mOut += char( 0 );
+      mLastField.pop_back();
+    }
+
+    void BeginList( int id, int elementType, size_t size ) {
+      FieldHeader( id, THRIFT_LIST );
+      if( size < 15 ) {
+        mOut += char( ( size << 4 ) | elementType );
+      } else {
+        mOut += char( 0xF0 | elementType );
+        PutVarint( mOut, size );
+      }
+    }
+
+    // Structs inside a list have no field header
+    void BeginListStruct() {
+      mLastField.push_back( 0 );
+    }
+
+    void ListI32( int32_t value ) {
+      PutVarint( mOut, ZigZag( value ) );
+    }
+
+    void ListString( const std::string& value ) {
+      PutVarint( mOut, value.size() );
+      mOut += value;
+    }
+  };
+}
+
+ParquetWriter::ParquetWriter( std::ostream& out )
+  : mOut( out ), mOffset( 0 ), mNumRows( 0 ), mBufferedRows( 0 ), mStarted( false ), mClosed( false )
+{
+}
+
+ParquetWriter::~ParquetWriter() {
+  if( mStarted && !mClosed ) {
+    Close();
+  }
+}
+
+int ParquetWriter::AddColumn( const std::string& name, ColumnType type, ColumnEncoding encoding ) {
+  assert( !mStarted );
+
+  // Delta only applies to integers, dictionary only to strings here
+  if( encoding == ENCODING_DELTA && ( type == COLUMN_BOOLEAN || type == COLUMN_STRING ) )
+    encoding = ENCODING_PLAIN;
+  if( encoding == ENCODING_DICTIONARY && type != COLUMN_STRING )
+    encoding = ENCODING_PLAIN;
+
+  Column column;
+  column.name = name;
+  column.type = type;
+  column.encoding = encoding;
+  mColumns.push_back( column );
+  return int( mColumns.size() ) - 1;
+}
+
+void ParquetWriter::Append( int column, int64_t value ) {
+  mStarted = true;
+  mColumns[ column ].ints.push_back( value );
+  if( column == 0 )
+    mBufferedRows++;
+}
+
+void ParquetWriter::Append( int column, const std::string& value ) {
+  mStarted = true;
+  Column& col = mColumns[ column ];
+  if( col.encoding == ENCODING_DICTIONARY ) {
+    auto it = col.dictionaryIndex.find( value );
+    if( it == col.dictionaryIndex.end() ) {
+      it = col.dictionaryIndex.emplace( value, uint32_t( col.dictionary.size() ) ).first;
+      col.dictionary.push_back( value );
+    }
+    col.indices.push_back( it->second );
+  } else {
+    col.strings.push_back( value );
+  }
+  if( column == 0 )
+    mBufferedRows++;
+}
+
+int64_t ParquetWriter::BufferedRows() const {
+  return mBufferedRows;
+}
+
+int64_t ParquetWriter::NumRows() const {
+  return mNumRows + mBufferedRows;
+}
+
+void ParquetWriter::Write( const std::string& data ) {
+  if( mOffset == 0 ) {
+    mOut.write( PARQUET_MAGIC, 4 );
+    mOffset = 4;
+  }
+  mOut.write( data.data(), data.size() );
+  mOffset += data.size();
+}
+
+void ParquetWriter::WritePage( int pageType, int numValues, int encoding, const std::string& body ) {
+  ThriftWriter header;
+  header.I32( 1, pageType );
+  header.I32( 2, int32_t( body.size() ) );
+  header.I32( 3, int32_t( body.size() ) );
+  if( pageType == PARQUET_PAGE_DATA ) {
+    header.BeginStruct( 5 );
+    header.I32( 1, numValues );
+    header.I32( 2, encoding );
+    header.I32( 3, PARQUET_ENCODING_RLE );
+    header.I32( 4, PARQUET_ENCODING_RLE );
+    header.EndStruct();
+  } else {
+    header.BeginStruct( 7 );
+    header.I32( 1, numValues );
+    header.I32( 2, encoding );
+    header.EndStruct();
+  }
+  header.EndStruct();
+
+  Write( header.Data() );
+  Write( body );
+}
+
+std::string ParquetWriter::EncodePlain( const Column& column ) {
+  std::string out;
+  switch( column.type ) {
+    case COLUMN_BOOLEAN: {
+      std::vector< uint64_t > bits( column.ints.begin(), column.ints.end() );
+      for( uint64_t& bit : bits ) bit = bit ? 1 : 0;
+      PutBitPacked( out, bits.data(), bits.size(), 1 );
+      break;
+    }
+    case COLUMN_INT32:
+      for( int64_t value : column.ints ) PutLittleEndian( out, uint32_t( value ), 4 );
+      break;
+    case COLUMN_INT64:
+    case COLUMN_TIMESTAMP:
+      for( int64_t value : column.ints ) PutLittleEndian( out, uint64_t( value ), 8 );
+      break;
+    case COLUMN_STRING: {
+      const std::vector< std::string >& strings = column.encoding == ENCODING_DICTIONARY ? column.dictionary : column.strings;
+      for( const std::string& value : strings ) {
+        PutLittleEndian( out, value.size(), 4 );
+        out += value;
+      }
+      break;
+    }
+  }
+  return out;
+}
+
+// Bit width byte followed by one bit-packed run (RLE/bit-packing hybrid)
+std::string ParquetWriter::EncodeDictionaryIndices( const std::vector< uint32_t >& indices, size_t dictionarySize ) {
+  int bitWidth = BitWidth( dictionarySize > 1 ? dictionarySize - 1 : 0 );
+
+  std::string out;
+  out += char( bitWidth );
+  if( bitWidth == 0 ) {
+    // Every value is index 0: a single RLE run
+    PutVarint( out, uint64_t( indices.size() ) << 1 );
+    return out;
+  }
+
+  size_t groups = ( indices.size() + 7 ) / 8;
+  std::vector< uint64_t > values( groups * 8, 0 );
+  std::copy( indices.begin(), indices.end(), values.begin() );
+  PutVarint( out, ( uint64_t( groups ) << 1 ) | 1 );
+  PutBitPacked( out, values.data(), values.size(), bitWidth );
+  return out;
+}
+
+// INT32 columns are decoded with 32 bit wrapping and at most 32 bits
+// per delta, so their deltas have to be computed that way, too
+std::string ParquetWriter::EncodeDelta( const std::vector< int64_t >& values, ColumnType type ) {
+  bool narrow = type == COLUMN_INT32;
+
+  std::string out;
+  PutVarint( out, PARQUET_DELTA_BLOCK_SIZE );
+  PutVarint( out, PARQUET_DELTA_MINIBLOCKS );
+  PutVarint( out, values.size() );
+  PutVarint( out, ZigZag( values.empty() ? 0 : values[ 0 ] ) );
+
+  for( size_t start = 1; start < values.size(); start += PARQUET_DELTA_BLOCK_SIZE ) {
+    size_t end = std::min( start + PARQUET_DELTA_BLOCK_SIZE, values.size() );
+
+    // Wrapping arithmetic, as the readers do
+    std::vector< uint64_t > deltas;
+    int64_t minDelta = INT64_MAX;
+    for( size_t i = start; i < end; i++ ) {
+      int64_t delta = narrow ?
+        int64_t( int32_t( uint32_t( values[ i ] ) - uint32_t( values[ i - 1 ] ) ) ) :
+        int64_t( uint64_t( values[ i ] ) - uint64_t( values[ i - 1 ] ) );
+      deltas.push_back( uint64_t( delta ) );
+      minDelta = std::min( minDelta, delta );
+    }
+    for( uint64_t& delta : deltas ) {
+      delta -= uint64_t( minDelta );
+    }
+    deltas.resize( PARQUET_DELTA_BLOCK_SIZE, 0 );
+
+    PutVarint( out, ZigZag( minDelta ) );
+
+    size_t count = end - start;
+    int bitWidths[ PARQUET_DELTA_MINIBLOCKS ];
+    for( int m = 0; m < PARQUET_DELTA_MINIBLOCKS; m++ ) {
+      uint64_t maxValue = 0;
+      for( int i = 0; i < PARQUET_DELTA_MINIBLOCK_SIZE; i++ ) {
+        maxValue = std::max( maxValue, deltas[ m * PARQUET_DELTA_MINIBLOCK_SIZE + i ] );
+      }
+      bitWidths[ m ] = m * PARQUET_DELTA_MINIBLOCK_SIZE < int( count ) ? BitWidth( maxValue ) : 0;
+      out += char( bitWidths[ m ] );
+    }
+
+    // Miniblocks past the last value are left out entirely
+    for( int m = 0; m < PARQUET_DELTA_MINIBLOCKS && m * PARQUET_DELTA_MINIBLOCK_SIZE < int( count ); m++ ) {
+      PutBitPacked( out, deltas.data() + m * PARQUET_DELTA_MINIBLOCK_SIZE, PARQUET_DELTA_MINIBLOCK_SIZE, bitWidths[ m ] );
+    }
+  }
+  return out;
+}
+
+ParquetWriter::ChunkInfo ParquetWriter::WriteColumnChunk( Column& column ) {
+  ChunkInfo chunk;
+  chunk.dictionaryPageOffset = -1;
+  chunk.numValues = column.encoding == ENCODING_DICTIONARY ? column.indices.size() :
+    column.type == COLUMN_STRING ? column.strings.size() : column.ints.size();
+
+  int64_t start = std::max< int64_t >( mOffset, 4 );
+  if( column.encoding == ENCODING_DICTIONARY ) {
+    chunk.dictionaryPageOffset = start;
+    WritePage( PARQUET_PAGE_DICTIONARY, int( column.dictionary.size() ), PARQUET_ENCODING_PLAIN, EncodePlain( column ) );
+    chunk.dataPageOffset = mOffset;
+    WritePage( PARQUET_PAGE_DATA, int( chunk.numValues ), PARQUET_ENCODING_RLE_DICTIONARY,
+        EncodeDictionaryIndices( column.indices, column.dictionary.size() ) );
+  } else if( column.encoding == ENCODING_DELTA ) {
+    chunk.dataPageOffset = start;
+    WritePage( PARQUET_PAGE_DATA, int( chunk.numValues ), PARQUET_ENCODING_DELTA_BINARY_PACKED, EncodeDelta( column.ints, column.type ) );
+  } else {
+    chunk.dataPageOffset = start;
+    WritePage( PARQUET_PAGE_DATA, int( chunk.numValues ), PARQUET_ENCODING_PLAIN, EncodePlain( column ) );
+  }
+  chunk.size = mOffset - start;
+
+  // Dictionaries are per row group
+  column.ints.clear();
+  column.strings.clear();
+  column.dictionaryIndex.clear();
+  column.dictionary.clear();
+  column.indices.clear();
+  return chunk;
+}
+
+void ParquetWriter::FlushRowGroup() {
+  if( mBufferedRows == 0 )
+    return;
+
+  RowGroupInfo rowGroup;
+  rowGroup.numRows = mBufferedRows;
+  rowGroup.size = 0;
+  for( Column& column : mColumns ) {
+    ChunkInfo chunk = WriteColumnChunk( column );
+    rowGroup.size += chunk.size;
+    rowGroup.chunks.push_back( chunk );
+  }
+  mRowGroups.push_back( rowGroup );
+
+  mNumRows += mBufferedRows;
+  mBufferedRows = 0;
+}
+
+std::string ParquetWriter::FileMetaData() const {
+  static const int physicalTypes[] = {
+    PARQUET_TYPE_BOOLEAN, PARQUET_TYPE_INT32, PARQUET_TYPE_INT64, PARQUET_TYPE_INT64, PARQUET_TYPE_BYTE_ARRAY
+  };
+
+  ThriftWriter meta;
+  meta.I32( 1, 1 );
+
+  meta.BeginList( 2, THRIFT_STRUCT, mColumns.size() + 1 );
+  meta.BeginListStruct();
+  meta.String( 4, "schema" );
+  meta.I32( 5, int32_t( mColumns.size() ) );
+  meta.EndStruct();
+  for( const Column& column : mColumns ) {
+    meta.BeginListStruct();
+    meta.I32( 1, physicalTypes[ column.type ] );
+    meta.I32( 3, 0 ); // REQUIRED
+    meta.String( 4, column.name );
+    if( column.type == COLUMN_STRING ) {
+      meta.I32( 6, PARQUET_CONVERTED_UTF8 );
+    } else if( column.type == COLUMN_TIMESTAMP ) {
+      meta.I32( 6, PARQUET_CONVERTED_TIMESTAMP_MILLIS );
+    }
+    meta.EndStruct();
+  }
+
+  meta.I64( 3, mNumRows );
+
+  meta.BeginList( 4, THRIFT_STRUCT, mRowGroups.size() );
+  for( const RowGroupInfo& rowGroup : mRowGroups ) {
+    meta.BeginListStruct();
+    meta.BeginList( 1, THRIFT_STRUCT, rowGroup.chunks.size() );
+    for( size_t i = 0; i < rowGroup.chunks.size(); i++ ) {
+      const ChunkInfo& chunk = rowGroup.chunks[ i ];
+      const Column& column = mColumns[ i ];
+
+      int encoding = column.encoding == ENCODING_DICTIONARY ? PARQUET_ENCODING_RLE_DICTIONARY :
+        column.encoding == ENCODING_DELTA ? PARQUET_ENCODING_DELTA_BINARY_PACKED : PARQUET_ENCODING_PLAIN;
+
+      meta.BeginListStruct();
+      meta.I64( 2, chunk.dataPageOffset );
+      meta.BeginStruct( 3 );
+      meta.I32( 1, physicalTypes[ column.type ] );
+      if( column.encoding == ENCODING_DICTIONARY ) {
+        meta.BeginList( 2, THRIFT_I32, 2 );
+        meta.ListI32( PARQUET_ENCODING_PLAIN );
+        meta.ListI32( encoding );
+      } else {
+        meta.BeginList( 2, THRIFT_I32, 1 );
+        meta.ListI32( encoding );
+      }
+      meta.BeginList( 3, THRIFT_BINARY, 1 );
+      meta.ListString( column.name );
+      meta.I32( 4, PARQUET_CODEC_UNCOMPRESSED );
+      meta.I64( 5, chunk.numValues );
+      meta.I64( 6, chunk.size );
+      meta.I64( 7, chunk.size );
+      meta.I64( 9, chunk.dataPageOffset );
+      if( chunk.dictionaryPageOffset >= 0 ) {
+        meta.I64( 11, chunk.dictionaryPageOffset );
+      }
+      meta.EndStruct();
+      meta.EndStruct();
+    }
+    meta.I64( 2, rowGroup.size );
+    meta.I64( 3, rowGroup.numRows );
+    meta.EndStruct();
+  }
+
+  meta.String( 6, PARQUET_CREATED_BY );
+  meta.EndStruct();
+  return meta.Data();
+}
+
+bool ParquetWriter::Close() {
+  if( mClosed )
+    return bool( mOut );
+
+  FlushRowGroup();
+
+  std::string footer = FileMetaData();
+  PutLittleEndian( footer, footer.size(), 4 );
+  footer += PARQUET_MAGIC;
+  Write( footer );
+  mOut.flush();
+
+  mClosed = true;
+  return bool( mOut );
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Minimal Apache Parquet writer for flat tables of required columns
+//
+// Rows are buffered per column and written out as one row group on
+// FlushRowGroup, so memory stays bounded by the row group size no
+// matter how many rows the file ends up with. Columns are stored
+// uncompressed, with the encoding picked per column:
+//
+//  - PLAIN
+//  - DICTIONARY: one dictionary page per row group, values as
+//    bit-packed indices (RLE_DICTIONARY). For strings with few
+//    distinct values (card ids, classes)
+//  - DELTA: DELTA_BINARY_PACKED, for timestamps and other ascending
+//    integers
+class ParquetWriter {
+public:
+  typedef enum {
+    COLUMN_BOOLEAN,
+    COLUMN_INT32,
+    COLUMN_INT64,
+    COLUMN_TIMESTAMP, // INT64, ms since epoch (UTC)
+    COLUMN_STRING
+  } ColumnType;
+
+  typedef enum {
+    ENCODING_PLAIN,
+    ENCODING_DICTIONARY,
+    ENCODING_DELTA
+  } ColumnEncoding;
+
+private:
+  typedef struct {
+    int64_t dictionaryPageOffset; // -1 if none
+    int64_t dataPageOffset;
+    int64_t size;
+    int64_t numValues;
+  } ChunkInfo;
+
+  typedef struct {
+    int64_t numRows;
+    int64_t size;
+    std::vector< ChunkInfo > chunks;
+  } RowGroupInfo;
+
+  typedef struct {
+    std::string    name;
+    ColumnType     type;
+    ColumnEncoding encoding;
+
+    std::vector< int64_t >     ints;
+    std::vector< std::string > strings;
+
+    std::unordered_map< std::string, uint32_t > dictionaryIndex;
+    std::vector< std::string > dictionary;
+    std::vector< uint32_t >    indices;
+  } Column;
+
+  std::ostream& mOut;
+  int64_t mOffset;
+  int64_t mNumRows;
+  int64_t mBufferedRows;
+  std::vector< Column > mColumns;
+  std::vector< RowGroupInfo > mRowGroups;
+  bool mStarted;
+  bool mClosed;
+
+  void Write( const std::string& data );
+  ChunkInfo WriteColumnChunk( Column& column );
+  void WritePage( int pageType, int numValues, int encoding, const std::string& body );
+  std::string FileMetaData() const;
+
+  static std::string EncodePlain( const Column& column );
+  static std::string EncodeDictionaryIndices( const std::vector< uint32_t >& indices, size_t dictionarySize );
+
+public:
+  ParquetWriter( std::ostream& out );
+  ~ParquetWriter();
+
+  // All columns have to be added before the first value
+  int AddColumn( const std::string& name, ColumnType type, ColumnEncoding encoding = ENCODING_PLAIN );
+
+  // One value per column makes a row
+  void Append( int column, int64_t value );
+  void Append( int column, const std::string& value );
+
+  int64_t BufferedRows() const;
+  int64_t NumRows() const;
+
+  void FlushRowGroup();
+
+  // Writes the footer, the file is unusable without it
+  bool Close();
+
+  static std::string EncodeDelta( const std::vector< int64_t >& values, ColumnType type = COLUMN_INT64 );
+};
@@ -5,8 +5,7 @@
 
 #include <cassert>
 #include <cmath>
-
-#define RC_PROBA_THRESHOLD 0.95 // return 0/RANK_UNKNOWN when best output below this threshold (prob. since we use SOFTMAX)
+#include <cstring>
 
 // The width / height of the rank label
 #define RC_LABEL_WIDTH 28
@@ -21,82 +20,114 @@
 #define RC_CAPTURE_SCREEN_WIDTH  1920
 #define RC_CAPTURE_SCREEN_HEIGHT 1080
 
+// Jittered crops: offsets of -RC_JITTER, 0, +RC_JITTER (canvas pixels) in both directions
+#define RC_JITTER 2
+#define RC_JITTER_STEPS 3
+
 // Ranks are displayed in white
 // Binarize images to get rid of the noise
 // Use HSV thresholds (matching pixel values are considered 1, otherwise 0)
 #define RC_BINARIZE_MAX_SATURATION 5
 #define RC_BINARIZE_MIN_VALUE 50
 
-#include <QJsonArray>
-#include <QJsonObject>
-#include <QJsonDocument>
+// Labels seen during a few matches, the cache starts over when full
+#define RC_CACHE_MAX_ENTRIES 64
+
+#include <QResource>
 #include <QFile>
+#include <QtEndian>
 
-RankClassifier::RankClassifier() {
-  LoadMLP();
-}
+#define RC_MODEL_PATH ":/data/rank_classifier.bin"
+#define RC_MODEL_MAGIC "TOBM"
+#define RC_MODEL_VERSION 1
 
-MLP::Vector JsonArrayToVector( const QJsonValue& val ) {
-  MLP::Vector res;
-  const QJsonArray& arr = val.toArray();
-  std::transform( arr.begin(), arr.end(), std::back_inserter( res ), []( QJsonValue ref ) {
-    return ( float )ref.toDouble();
-  });
-  return res;
+RankClassifier::RankClassifier()
+  : mCacheEnabled( true )
+{
+  LoadMLP();
 }
 
+// Binary model generated by dist/build_rank_classifier.rb
+// All values are stored little-endian
 void RankClassifier::LoadMLP() {
-  QFile file( ":/data/rank_classifier.json" );
-  bool opened = file.open( QIODevice::ReadOnly | QIODevice::Text );
-  assert( opened );
-
-  QByteArray jsonData = file.readAll();
-  QJsonParseError error;
-  QJsonObject jsonLayers = QJsonDocument::fromJson( jsonData, &error ).object();
-  assert( error.error == QJsonParseError::NoError );
-
-  for( QJsonValueRef jsonLayerRef : jsonLayers ) {
-    QJsonObject jsonLayer = jsonLayerRef.toObject();
-    MLP::Layer layer;
-
-    // type
-    QString type = jsonLayer["type"].toString();
-    if( type == "SOFTMAX" ) {
-      layer.type = MLP::LAYER_SOFTMAX;
-    } else if( type == "SIGMOID" ) {
-      layer.type = MLP::LAYER_SIGMOID;
-    } else if( type == "RECTIFIER" ) {
-      layer.type = MLP::LAYER_RECTIFIER;
-    } else {
-      assert( "Unknown layer type" );
+  QByteArray buffer;
+  QResource resource( RC_MODEL_PATH );
+  const uchar *data = resource.data();
+  qint64 size = resource.size();
+
+  // Uncompressed resources can be used in place
+  if( !data || resource.isCompressed() ) {
+    QFile file( RC_MODEL_PATH );
+    bool opened = file.open( QIODevice::ReadOnly );
+    assert( opened );
+    UNUSED_ARG( opened );
+
+    buffer = file.readAll();
+    data = reinterpret_cast< const uchar* >( buffer.constData() );
+    size = buffer.size();
+  }
+
+  const uchar *end = data + size;
+  const int headerSize = 12;
+  if( size < headerSize || memcmp( data, RC_MODEL_MAGIC, 4 ) != 0 ||
+      qFromLittleEndian< quint32 >( data + 4 ) != RC_MODEL_VERSION )
+  {
+    ERR( "Invalid rank classifier model" );
+    return;
+  }
+
+  int numLayers = qFromLittleEndian< quint32 >( data + 8 );
+  data += headerSize;
+
+  for( int i = 0; i < numLayers; i++ ) {
+    if( end - data < 12 ) {
+      ERR( "Rank classifier model truncated" );
+      return;
     }
 
-    // biases
-    layer.biases = JsonArrayToVector( jsonLayer[ "biases" ] );
+    MLP::LayerType type = ( MLP::LayerType )qFromLittleEndian< quint32 >( data );
+    int numInputs = qFromLittleEndian< quint32 >( data + 4 );
+    int numOutputs = qFromLittleEndian< quint32 >( data + 8 );
+    data += 12;
 
-    // weight matrix
-    QJsonArray rows = jsonLayer[ "weights" ].toArray();
-    std::transform( rows.begin(), rows.end(), std::back_inserter( layer.weights ), []( QJsonValueRef ref ) {
-      return JsonArrayToVector( ref );
-    });
+    int numValues = numOutputs + numOutputs * numInputs;
+    if( end - data < qint64( numValues ) * 4 ) {
+      ERR( "Rank classifier model truncated" );
+      return;
+    }
+
+    const float *values = reinterpret_cast< const float* >( data );
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    std::vector< float > swapped( numValues );
+    for( int j = 0; j < numValues; j++ ) {
+      quint32 raw = qFromLittleEndian< quint32 >( data + j * 4 );
+      memcpy( &swapped[ j ], &raw, 4 );
+    }
+    values = swapped.data();
+#endif
 
     DBG( "Load layer: %d biases | %dx%d weights (type %d)",
-        layer.biases.size(),
-        layer.weights.size(),
-        layer.weights.front().size(),
-        layer.type);
+        numOutputs, numOutputs, numInputs, type );
 
-    mMLP.AddLayer( layer );
+    mMLP.AddLayer( type, numInputs, numOutputs, values, values + numOutputs );
+    data += numValues * 4;
   }
+
+  DBG( "Rank classifier uses %d bytes", (int)mMLP.WeightsSize() );
 }
 
-int RankClassifier::Classify( const QImage& label, float *outScore ) const {
-  assert( label.width() == RC_LABEL_WIDTH );
-  assert( label.height() == RC_LABEL_HEIGHT );
+size_t RankClassifier::ModelSize() const {
+  return mMLP.WeightsSize();
+}
 
-  MLP::Vector input = BinarizeImageSV( label, RC_BINARIZE_MAX_SATURATION, RC_BINARIZE_MIN_VALUE );
+// Benchmarks want every label to go through the MLP
+void RankClassifier::SetCacheEnabled( bool enabled ) {
+  QMutexLocker lock( &mCacheMutex );
+  mCacheEnabled = enabled;
+  mCache.clear();
+}
 
-  MLP::Vector result = mMLP.Compute( input );
+int RankClassifier::Decide( const MLP::Vector& result, float *outScore ) {
   std::vector< std::pair<int, float> > scores;
   for( int i = 0; i < (int)result.size(); i++ ) {
     scores.push_back( std::pair< int, float >( i, result[ i ] ) );
@@ -123,85 +154,251 @@ int RankClassifier::Classify( const QImage& label, float *outScore ) const {
   return rank;
 }
 
+int RankClassifier::ClassifyLabel( const QImage& label, float *outScore, bool *outCached ) const {
+  assert( label.width() == RC_LABEL_WIDTH );
+  assert( label.height() == RC_LABEL_HEIGHT );
+
+  MLP::Vector input = BinarizeImageSV( label, RC_BINARIZE_MAX_SATURATION, RC_BINARIZE_MIN_VALUE );
+
+  QByteArray key( ( input.size() + 7 ) / 8, 0 );
+  for( int i = 0; i < (int)input.size(); i++ ) {
+    if( input[ i ] > 0.0f ) {
+      key[ i / 8 ] = char( key[ i / 8 ] | ( 1 << ( i % 8 ) ) );
+    }
+  }
+
+  {
+    QMutexLocker lock( &mCacheMutex );
+    auto it = mCache.constFind( key );
+    if( mCacheEnabled && it != mCache.constEnd() ) {
+      DBG( "Label already classified. Return %d", it->first );
+      if( outScore )
+        *outScore = it->second;
+      if( outCached )
+        *outCached = true;
+      return it->first;
+    }
+  }
+
+  float bestScore;
+  int rank = Decide( mMLP.Compute( input ), &bestScore );
+  if( outScore )
+    *outScore = bestScore;
+
+  {
+    QMutexLocker lock( &mCacheMutex );
+    if( !mCacheEnabled ) {
+      return rank;
+    }
+    if( mCache.size() >= RC_CACHE_MAX_ENTRIES ) {
+      mCache.clear();
+    }
+    mCache.insert( key, CachedClassification( rank, bestScore ) );
+  }
+
+  return rank;
+}
+
 int RankClassifier::DetectCurrentRank( float *outScore, QImage *outLabel ) {
-  // Grab label
-  QImage raw = Hearthstone::Instance()->Capture( RC_CAPTURE_SCREEN_WIDTH, RC_CAPTURE_SCREEN_HEIGHT,
+  QImage label;
+  CaptureLabel( &label );
+  return Classify( label, outScore, outLabel );
+}
+
+// Screen capture has to happen on the GUI thread
+// The backend scales the label down, so Classify does not need to
+bool RankClassifier::CaptureLabel( QImage *label ) {
+  if( label->size() != QSize( RC_LABEL_WIDTH, RC_LABEL_HEIGHT ) || label->format() != QImage::Format_RGB32 ) {
+    *label = QImage( RC_LABEL_WIDTH, RC_LABEL_HEIGHT, QImage::Format_RGB32 );
+  }
+
+  return Hearthstone::Instance()->CaptureInto( RC_CAPTURE_SCREEN_WIDTH, RC_CAPTURE_SCREEN_HEIGHT,
       RC_CAPTURE_X, RC_CAPTURE_Y,
-      RC_CAPTURE_WIDTH, RC_CAPTURE_HEIGHT ).toImage();
+      RC_CAPTURE_WIDTH, RC_CAPTURE_HEIGHT, label );
+}
 
+// Thread safe, can run on a worker with a captured label
+int RankClassifier::Classify( const QImage& raw, float *outScore, QImage *outLabel, bool *outCached ) const {
   QImage label = raw.scaled( QSize( RC_LABEL_WIDTH, RC_LABEL_HEIGHT ),
     Qt::IgnoreAspectRatio,
     Qt::SmoothTransformation );
 
+  if( outCached )
+    *outCached = false;
+
   if( label.width() != RC_LABEL_WIDTH || label.height() != RC_LABEL_HEIGHT ) {
+    if( outScore )
+      *outScore = 0.0f;
     return 0;
   }
 
   if( outLabel )
     *outLabel = label;
 
-  return Classify( label, outScore );
+  return ClassifyLabel( label, outScore, outCached );
+}
+
+// Capture a bit more than the label, so crops can be shifted around it
+// Scaled to canvas pixels, so the jitter offsets map to whole pixels
+bool RankClassifier::CaptureJitteredLabels( QImage *labels ) {
+  QSize size( RC_CAPTURE_WIDTH + 2 * RC_JITTER, RC_CAPTURE_HEIGHT + 2 * RC_JITTER );
+  if( labels->size() != size || labels->format() != QImage::Format_RGB32 ) {
+    *labels = QImage( size, QImage::Format_RGB32 );
+  }
+
+  return Hearthstone::Instance()->CaptureInto( RC_CAPTURE_SCREEN_WIDTH, RC_CAPTURE_SCREEN_HEIGHT,
+      RC_CAPTURE_X - RC_JITTER, RC_CAPTURE_Y - RC_JITTER,
+      size.width(), size.height(), labels );
+}
+
+// Classify all jittered crops of a CaptureJitteredLabels image in one batch
+// Returns one (rank, score) vote per crop
+QList< QPair< int, float > > RankClassifier::ClassifyJittered( const QImage& raw ) const {
+  QList< QPair< int, float > > votes;
+
+  float scaleX = raw.width() / float( RC_CAPTURE_WIDTH + 2 * RC_JITTER );
+  float scaleY = raw.height() / float( RC_CAPTURE_HEIGHT + 2 * RC_JITTER );
+  int cropWidth = qRound( RC_CAPTURE_WIDTH * scaleX );
+  int cropHeight = qRound( RC_CAPTURE_HEIGHT * scaleY );
+
+  MLP::Matrix inputs;
+  for( int j = 0; j < RC_JITTER_STEPS; j++ ) {
+    for( int i = 0; i < RC_JITTER_STEPS; i++ ) {
+      int dx = i * RC_JITTER; // 0 .. 2 * RC_JITTER, RC_JITTER is centered
+      int dy = j * RC_JITTER;
+
+      QImage crop = raw.copy( qRound( dx * scaleX ), qRound( dy * scaleY ), cropWidth, cropHeight );
+      QImage label = crop.scaled( QSize( RC_LABEL_WIDTH, RC_LABEL_HEIGHT ),
+          Qt::IgnoreAspectRatio,
+          Qt::SmoothTransformation );
+
+      if( label.width() == RC_LABEL_WIDTH && label.height() == RC_LABEL_HEIGHT ) {
+        inputs.push_back( BinarizeImageSV( label, RC_BINARIZE_MAX_SATURATION, RC_BINARIZE_MIN_VALUE ) );
+      }
+    }
+  }
+
+  if( inputs.empty() )
+    return votes;
+
+  for( const MLP::Vector& result : mMLP.ComputeBatch( inputs ) ) {
+    float score;
+    int rank = Decide( result, &score );
+    votes << QPair< int, float >( rank, score );
+  }
+
+  return votes;
+}
+
+// Percentages are computed like QColor::getHsv + int(float(c) / 255.0f * 100.0f)
+// would (same float expressions), so the integer thresholds are exact
+static int LargestChannelWithin( float maxPercentage ) {
+  int largest = -1;
+  for( int c = 0; c < 256; c++ ) {
+    if( int( float( c ) / 255.0f * 100.0f ) <= maxPercentage ) {
+      largest = c;
+    }
+  }
+  return largest;
+}
+
+static int SmallestChannelAbove( float minPercentage ) {
+  for( int c = 0; c < 256; c++ ) {
+    if( int( float( c ) / 255.0f * 100.0f ) >= minPercentage ) {
+      return c;
+    }
+  }
+  return 256;
 }
 
 MLP::Vector RankClassifier::BinarizeImageSV( const QImage& img, float maxSaturation, float minValue ) {
-  MLP::Vector bin( img.width() * img.height() );
+  // pixel() unpremultiplies, so do the same for any other format once
+  const QImage src = ( img.format() == QImage::Format_RGB32 || img.format() == QImage::Format_ARGB32 ) ?
+    img : img.convertToFormat( QImage::Format_RGB32 );
+
+  int width = src.width();
+  int height = src.height();
+
+  // QColor value is the largest channel (v = max)
+  // QColor saturation is qRound( (max - min) / max * 65535 ) >> 8 (for max != min)
+  // so s <= sMax <=> (max - min) * 65535 / max < (sMax + 1) * 256 - 0.5
+  // which gives the largest allowed max - min for every max
+  int vMin = SmallestChannelAbove( minValue );
+  int sMax = LargestChannelWithin( maxSaturation );
+
+  int maxDelta[ 256 ];
+  for( int max = 0; max < 256; max++ ) {
+    maxDelta[ max ] = -1;
+    if( max < vMin || sMax < 0 )
+      continue;
+
+    // max == min always has saturation 0
+    maxDelta[ max ] = 0;
+
+    qint64 limit = qint64( ( sMax + 1 ) * 512 - 1 ) * max;
+    for( int delta = 1; delta <= max; delta++ ) {
+      if( qint64( delta ) * 131070 >= limit )
+        break;
+      maxDelta[ max ] = delta;
+    }
+  }
 
-  float sumX = 0.0f;
-  float sumY = 0.0f;
+  // Binarize and accumulate the centroid in one pass
+  // Sums of x + 0.5 are kept as exact integers (2x + 1)
+  std::vector< uchar > bin( width * height );
+  int sum2X = 0;
+  int sum2Y = 0;
   int area = 0;
 
-  for( int y = 0; y < img.height(); y++ ) {
-    for( int x = 0; x < img.width(); x++ ) {
-      int idx = y * img.width() + x;
+  for( int y = 0; y < height; y++ ) {
+    const QRgb *line = reinterpret_cast< const QRgb* >( src.constScanLine( y ) );
+    uchar *out = &bin[ y * width ];
 
-      QRgb pixel = img.pixel( x, y );
+    for( int x = 0; x < width; x++ ) {
+      QRgb pixel = line[ x ];
+      int r = qRed( pixel );
+      int g = qGreen( pixel );
+      int b = qBlue( pixel );
 
-      int h, s, v;
-      QColor( pixel ).getHsv( &h, &s, &v );
+      int max = std::max( r, std::max( g, b ) );
+      int min = std::min( r, std::min( g, b ) );
 
-      h = std::max(0, h);
-      s = int(float(s) / 255.0f * 100.0f);
-      v = int(float(v) / 255.0f * 100.0f);
+      uchar white = ( max - min ) <= maxDelta[ max ];
+      out[ x ] = white;
 
-      bool white = ( s <= maxSaturation && v >= minValue );
-      bin[ idx ] = white ? 1.0f : 0.0f;
-
-      if( white ) {
-        sumX += (float(x) + 0.5f);
-        sumY += (float(y) + 0.5f);
-        area++;
-      }
+      sum2X += white * ( 2 * x + 1 );
+      sum2Y += white * ( 2 * y + 1 );
+      area += white;
     }
   }
 
-  MLP::Vector binCentered( img.width() * img.height(), 0.0f );
+  MLP::Vector binCentered( width * height, 0.0f );
 
-  float imageCenterX = img.width() * 0.5f;
-  float imageCenterY = img.height() * 0.5f;
+  float imageCenterX = width * 0.5f;
+  float imageCenterY = height * 0.5f;
 
-  float gravityX = area ? sumX / area : imageCenterX;
-  float gravityY = area ? sumY / area : imageCenterY;
+  // float sums of half integers are exact in this range,
+  // so this matches accumulating x + 0.5 as float
+  float gravityX = area ? ( sum2X * 0.5f ) / area : imageCenterX;
+  float gravityY = area ? ( sum2Y * 0.5f ) / area : imageCenterY;
 
   int offsetX = std::round(imageCenterX - gravityX);
   int offsetY = std::round(imageCenterY - gravityY);
 
-  for( int y = 0; y < img.height(); y++ ) {
-    for( int x = 0; x < img.width(); x++ ) {
-      int idx = y * img.width() + x;
-      float val = bin[ idx ];
-
-      int newX = x + offsetX;
-      int newY = y + offsetY;
-
-      if( newX >= 0 && newX < img.width() &&
-          newY >= 0 && newY < img.height() )
-      {
-        int newIdx = newY * img.width() + newX;
-        binCentered[ newIdx ] = val;
-      }
+  // Shift whole rows, only the overlapping part survives
+  int x0 = std::max( 0, -offsetX );
+  int x1 = std::min( width, width - offsetX );
+  for( int y = 0; y < height; y++ ) {
+    int newY = y + offsetY;
+    if( newY < 0 || newY >= height )
+      continue;
+
+    const uchar *in = &bin[ y * width ];
+    float *out = &binCentered[ newY * width ];
+    for( int x = x0; x < x1; x++ ) {
+      out[ x + offsetX ] = in[ x ];
     }
   }
 
   return binCentered;
 }
-
@@ -1,20 +1,46 @@
 #pragma once
 
 #include <QImage>
+#include <QHash>
+#include <QMutex>
 
 #include "MLP.h"
 
+#define RC_PROBA_THRESHOLD 0.95 // return 0/RANK_UNKNOWN when best output below this threshold (prob. since we use SOFTMAX)
+#define RC_NUM_RANKS 25
+
 class RankClassifier
 {
-private:
+protected:
+  // Tests and benchmarks swap in int8 weights, see test/QuantizableRankClassifier.h
   MLP::MultiLayerPerceptron mMLP;
 
-  static MLP::Vector BinarizeImageSV( const QImage& img, float maxSaturation, float minValue );
+private:
+  // The badge does not change during a match, so remember
+  // the outcome for each binarized label (packed bits)
+  typedef QPair< int, float > CachedClassification;
+  mutable QHash< QByteArray, CachedClassification > mCache;
+  mutable QMutex mCacheMutex;
+  bool mCacheEnabled;
 
   void LoadMLP();
-  int Classify( const QImage& label, float *outScore ) const;
+  int ClassifyLabel( const QImage& label, float *outScore, bool *outCached ) const;
+  static int Decide( const MLP::Vector& result, float *outScore );
 
 public:
   RankClassifier();
   int DetectCurrentRank( float *outScore, QImage *outLabel );
+
+  // Captures into *label, which keeps its buffer across calls
+  // (allocated on first use, already scaled for Classify)
+  static bool CaptureLabel( QImage *label );
+  int Classify( const QImage& raw, float *outScore, QImage *outLabel, bool *outCached = NULL ) const;
+
+  static bool CaptureJitteredLabels( QImage *labels );
+  QList< QPair< int, float > > ClassifyJittered( const QImage& raw ) const;
+
+  size_t ModelSize() const;
+  void SetCacheEnabled( bool enabled );
+
+  static MLP::Vector BinarizeImageSV( const QImage& img, float maxSaturation, float minValue );
 };
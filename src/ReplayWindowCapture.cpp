@@ -0,0 +1,162 @@
+#include "ReplayWindowCapture.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#define REPLAY_INDEX_FILE "frames.txt"
+
+ReplayWindowCapture::ReplayWindowCapture( const QString& directory )
+  : mFrameIndex( 0 ), mLoop( false ), mFrameInterval( 0 ), mLoadedIndex( -1 )
+{
+  if( !LoadIndex( directory ) ) {
+    LoadDirectory( directory );
+  }
+
+  LOG( "Replay %d frames from %s", mFrames.size(), qt2cstr( directory ) );
+  mFrameTimer.start();
+}
+
+bool ReplayWindowCapture::LoadIndex( const QString& directory ) {
+  QFile file( QDir( directory ).filePath( REPLAY_INDEX_FILE ) );
+  if( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    return false;
+
+  QTextStream in( &file );
+  while( !in.atEnd() ) {
+    QString line = in.readLine().trimmed();
+    if( line.isEmpty() || line.startsWith( '#' ) )
+      continue;
+
+    QStringList fields = line.split( QRegExp( "\\s+" ) );
+    if( fields.size() < 3 ) {
+      ERR( "Invalid replay frame: %s", qt2cstr( line ) );
+      continue;
+    }
+
+    ReplayFrame frame;
+    frame.path = QDir( directory ).filePath( fields[ 0 ] );
+    frame.position = QPoint( fields[ 1 ].toInt(), fields[ 2 ].toInt() );
+    frame.focus = fields.size() > 3 ? fields[ 3 ].toInt() != 0 : true;
+    frame.duration = fields.size() > 4 ? fields[ 4 ].toInt() : 0;
+    mFrames << frame;
+  }
+  return true;
+}
+
+void ReplayWindowCapture::LoadDirectory( const QString& directory ) {
+  QDir dir( directory );
+  foreach( const QString& name, dir.entryList( QStringList() << "*.png", QDir::Files, QDir::Name ) ) {
+    ReplayFrame frame;
+    frame.path = dir.filePath( name );
+    frame.position = QPoint( 0, 0 );
+    frame.focus = true;
+    frame.duration = 0;
+    mFrames << frame;
+  }
+}
+
+int ReplayWindowCapture::NumFrames() const {
+  return mFrames.size();
+}
+
+int ReplayWindowCapture::FrameIndex() const {
+  return mFrameIndex;
+}
+
+void ReplayWindowCapture::SetFrameInterval( int ms ) {
+  mFrameInterval = ms;
+  mFrameTimer.restart();
+}
+
+void ReplayWindowCapture::SetLoop( bool loop ) {
+  mLoop = loop;
+}
+
+void ReplayWindowCapture::NextFrame() {
+  SeekFrame( mFrameIndex + 1 );
+}
+
+void ReplayWindowCapture::SeekFrame( int index ) {
+  if( mLoop && !mFrames.isEmpty() ) {
+    index %= mFrames.size();
+  }
+
+  mFrameIndex = qMin( index, mFrames.size() );
+  mFrameTimer.restart();
+}
+
+void ReplayWindowCapture::AdvanceByTime() {
+  if( mFrameIndex >= mFrames.size() )
+    return;
+
+  int duration = mFrames[ mFrameIndex ].duration ? mFrames[ mFrameIndex ].duration : mFrameInterval;
+  if( duration > 0 && mFrameTimer.elapsed() >= duration ) {
+    int index = mFrameIndex + 1;
+    mFrameIndex = ( mLoop && index >= mFrames.size() ) ? 0 : index;
+    mFrameTimer.restart();
+  }
+}
+
+const QImage& ReplayWindowCapture::CurrentImage() {
+  AdvanceByTime();
+
+  if( mFrameIndex >= mFrames.size() ) {
+    mImage = QImage();
+    mLoadedIndex = -1;
+  } else if( mLoadedIndex != mFrameIndex ) {
+    mImage = QImage( mFrames[ mFrameIndex ].path ).convertToFormat( QImage::Format_RGB32 );
+    mLoadedIndex = mFrameIndex;
+
+    if( mImage.isNull() ) {
+      ERR( "Could not load replay frame %s", qt2cstr( mFrames[ mFrameIndex ].path ) );
+    }
+  }
+
+  return mImage;
+}
+
+// The game stops when the replay runs out of frames
+bool ReplayWindowCapture::WindowFound() {
+  return !CurrentImage().isNull();
+}
+
+int ReplayWindowCapture::Width() {
+  return CurrentImage().width();
+}
+
+int ReplayWindowCapture::Height() {
+  return CurrentImage().height();
+}
+
+int ReplayWindowCapture::Left() {
+  return WindowFound() ? mFrames[ mFrameIndex ].position.x() : 0;
+}
+
+int ReplayWindowCapture::Top() {
+  return WindowFound() ? mFrames[ mFrameIndex ].position.y() : 0;
+}
+
+bool ReplayWindowCapture::HasFocus() {
+  return WindowFound() && mFrames[ mFrameIndex ].focus;
+}
+
+QPixmap ReplayWindowCapture::Capture( int x, int y, int w, int h ) {
+  return QPixmap::fromImage( CaptureImage( x, y, w, h ) );
+}
+
+QImage ReplayWindowCapture::CaptureImage( int x, int y, int w, int h ) {
+  return CurrentImage().copy( x, y, w, h );
+}
+
+bool ReplayWindowCapture::CaptureInto( int x, int y, int w, int h, QImage *target ) {
+  const QImage& image = CurrentImage();
+  QRect rect( x, y, w, h );
+
+  if( !image.rect().contains( rect ) )
+    return CopyScaled( image.copy( rect ), target );
+
+  // Wrap the region of the frame, no copy
+  QImage region( image.constScanLine( y ) + x * 4, w, h, image.bytesPerLine(), image.format() );
+  return CopyScaled( region, target );
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "WindowCapture.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QRect>
+
+// Serves recorded screenshots instead of a live game window
+// Lets the overlay, the rank classifier and Hearthstone::Update
+// run without the game (and without a display beyond Xvfb)
+//
+// The directory either holds an index file frames.txt with one frame per line:
+//   <file> <left> <top> [<focus 0|1> [<duration ms>]]
+// or just PNG files, which are played in name order at 0,0 with focus.
+// The window size of a frame is the size of its screenshot.
+class ReplayWindowCapture : public WindowCapture
+{
+private:
+  typedef struct {
+    QString path;
+    QPoint  position;
+    bool    focus;
+    int     duration; // ms, 0 = use the frame interval
+  } ReplayFrame;
+
+  QList< ReplayFrame > mFrames;
+  int mFrameIndex;
+  bool mLoop;
+  int mFrameInterval;
+  QElapsedTimer mFrameTimer;
+
+  // Only the current frame is kept decoded
+  int mLoadedIndex;
+  QImage mImage;
+
+  bool LoadIndex( const QString& directory );
+  void LoadDirectory( const QString& directory );
+  void AdvanceByTime();
+  const QImage& CurrentImage();
+
+public:
+  ReplayWindowCapture( const QString& directory );
+
+  int NumFrames() const;
+  int FrameIndex() const;
+
+  // Frame pacing
+  // With an interval, frames advance on their own (e.g. one per turn)
+  // Without (0, the default), only NextFrame advances; deterministic
+  void SetFrameInterval( int ms );
+  void SetLoop( bool loop );
+  void NextFrame();
+  void SeekFrame( int index );
+
+  bool WindowFound();
+  int Width();
+  int Height();
+
+  int Left();
+  int Top();
+
+  QPixmap Capture( int x, int y, int w, int h );
+  QImage CaptureImage( int x, int y, int w, int h );
+  bool CaptureInto( int x, int y, int w, int h, QImage *target );
+
+  bool HasFocus();
+};
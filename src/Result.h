@@ -5,6 +5,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QDateTime>
+#include <QCryptographicHash>
 #include <QString>
 #include <QList>
 
@@ -148,8 +149,21 @@ public:
     region = "";
   }
 
+  // Stable for the same match, sent along as idempotency key so retries
+  // of an upload the server already stored do not count it twice
+  QString Id() const {
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    hash.addData( QByteArray::number( added.toMSecsSinceEpoch() ) );
+    hash.addData( QByteArray::number( mode ) + ":" + QByteArray::number( hero ) + ":" + QByteArray::number( opponent ) );
+    for( const CardHistoryItem& chi : cardList ) {
+      hash.addData( ";" + QByteArray::number( chi.turn ) + ":" + QByteArray::number( chi.player ) + ":" + chi.cardId.toLatin1() );
+    }
+    return QString::fromLatin1( hash.result().toHex() );
+  }
+
   QJsonObject AsJson() const {
     QJsonObject result;
+    result[ "client_id" ] = Id();
     result[ "coin" ]     = ( order == ORDER_SECOND );
     result[ "hero" ]     = CLASS_NAMES[ hero ];
     result[ "opponent" ] = CLASS_NAMES[ opponent ];
@@ -0,0 +1,128 @@
+#include "ResultExporter.h"
+#include "ParquetWriter.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <fstream>
+
+#define RESULT_EXPORT_RESULTS_FILE "results.parquet"
+#define RESULT_EXPORT_CARDS_FILE "card_history.parquet"
+
+// Some of the name tables are shorter than their enum
+template< size_t N >
+static std::string EnumName( const char (&names)[ N ][ 128 ], int value ) {
+  return value >= 0 && value < int( N ) ? names[ value ] : "unknown";
+}
+
+static std::string JsonString( const QJsonObject& object, const char *key ) {
+  return object[ key ].toString().toStdString();
+}
+
+// Written next to the target first so a failed export leaves the previous one intact
+static bool ReplaceFile( const QString& partPath, const QString& path ) {
+  QFile::remove( path );
+  return QFile::rename( partPath, path );
+}
+
+ResultExporter::ResultExporter( ResultStore *store, int rowGroupSize )
+  : mStore( store ), mRowGroupSize( qMax( rowGroupSize, 1 ) ), mExportedResults( 0 ), mExportedCards( 0 )
+{
+}
+
+bool ResultExporter::Export( const QString& directory ) {
+  QElapsedTimer timer;
+  timer.start();
+
+  QDir dir( directory );
+  QString resultsPath = dir.filePath( RESULT_EXPORT_RESULTS_FILE );
+  QString cardsPath = dir.filePath( RESULT_EXPORT_CARDS_FILE );
+
+  std::ofstream resultsFile( QFile::encodeName( resultsPath + ".part" ).constData(), std::ios::binary | std::ios::trunc );
+  std::ofstream cardsFile( QFile::encodeName( cardsPath + ".part" ).constData(), std::ios::binary | std::ios::trunc );
+  if( !resultsFile || !cardsFile ) {
+    ERR( "Could not write export to %s", qt2cstr( directory ) );
+    return false;
+  }
+
+  ParquetWriter results( resultsFile );
+  int resultId       = results.AddColumn( "id", ParquetWriter::COLUMN_INT32, ParquetWriter::ENCODING_DELTA );
+  int resultClientId = results.AddColumn( "client_id", ParquetWriter::COLUMN_STRING );
+  int resultAdded    = results.AddColumn( "added", ParquetWriter::COLUMN_TIMESTAMP, ParquetWriter::ENCODING_DELTA );
+  int resultMode     = results.AddColumn( "mode", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int resultOutcome  = results.AddColumn( "outcome", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int resultGoing    = results.AddColumn( "going", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int resultHero     = results.AddColumn( "hero", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int resultOpponent = results.AddColumn( "opponent", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int resultRank     = results.AddColumn( "rank", ParquetWriter::COLUMN_INT32 ); // 0: unknown or legend
+  int resultLegend   = results.AddColumn( "legend", ParquetWriter::COLUMN_INT32 ); // 0: not legend
+  int resultDuration = results.AddColumn( "duration", ParquetWriter::COLUMN_INT32 );
+  int resultRegion   = results.AddColumn( "region", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+
+  ParquetWriter cards( cardsFile );
+  int cardResult = cards.AddColumn( "result", ParquetWriter::COLUMN_INT32, ParquetWriter::ENCODING_DELTA );
+  int cardTurn   = cards.AddColumn( "turn", ParquetWriter::COLUMN_INT32, ParquetWriter::ENCODING_DELTA );
+  int cardPlayer = cards.AddColumn( "player", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  int cardId     = cards.AddColumn( "card_id", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+
+  const QVector< ResultStore::StoredResult >& rows = mStore->Results();
+  for( int i = 0; i < rows.size(); i++ ) {
+    const ResultStore::StoredResult& row = rows[ i ];
+    QJsonObject details = mStore->Details( i );
+
+    results.Append( resultId, int64_t( i ) );
+    results.Append( resultClientId, JsonString( details, "client_id" ) );
+    results.Append( resultAdded, int64_t( row.added ) );
+    results.Append( resultMode, EnumName( MODE_NAMES, row.mode ) );
+    results.Append( resultOutcome, EnumName( OUTCOME_NAMES, row.outcome ) );
+    results.Append( resultGoing, EnumName( ORDER_NAMES, row.order ) );
+    results.Append( resultHero, EnumName( CLASS_NAMES, row.hero ) );
+    results.Append( resultOpponent, EnumName( CLASS_NAMES, row.opponent ) );
+    results.Append( resultRank, int64_t( row.rank ) );
+    results.Append( resultLegend, int64_t( row.legend ) );
+    results.Append( resultDuration, int64_t( row.duration ) );
+    results.Append( resultRegion, JsonString( details, "region" ) );
+
+    for( const QJsonValue& value : details[ "card_history" ].toArray() ) {
+      QJsonObject item = value.toObject();
+      cards.Append( cardResult, int64_t( i ) );
+      cards.Append( cardTurn, int64_t( item[ "turn" ].toInt() ) );
+      cards.Append( cardPlayer, JsonString( item, "player" ) );
+      cards.Append( cardId, JsonString( item, "card_id" ) );
+    }
+
+    if( results.BufferedRows() >= mRowGroupSize ) {
+      results.FlushRowGroup();
+    }
+    if( cards.BufferedRows() >= mRowGroupSize ) {
+      cards.FlushRowGroup();
+    }
+  }
+
+  bool success = results.Close();
+  success = cards.Close() && success;
+  resultsFile.close();
+  cardsFile.close();
+  success = success && resultsFile && cardsFile &&
+    ReplaceFile( resultsPath + ".part", resultsPath ) && ReplaceFile( cardsPath + ".part", cardsPath );
+
+  if( !success ) {
+    ERR( "Export to %s failed", qt2cstr( directory ) );
+    QFile::remove( resultsPath + ".part" );
+    QFile::remove( cardsPath + ".part" );
+    return false;
+  }
+
+  mExportedResults = int( results.NumRows() );
+  mExportedCards = int( cards.NumRows() );
+  LOG( "Exported %d results and %d cards to %s in %lld ms", mExportedResults, mExportedCards, qt2cstr( directory ), timer.elapsed() );
+  return true;
+}
+
+int ResultExporter::ExportedResults() const {
+  return mExportedResults;
+}
+
+int ResultExporter::ExportedCards() const {
+  return mExportedCards;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ResultStore.h"
+
+#define RESULT_EXPORT_ROW_GROUP_SIZE 50000
+
+// Exports the result store as Parquet files for analytics tools
+// (pandas, DuckDB, Spark, ...):
+//
+//   results.parquet       one row per game
+//   card_history.parquet  one row per card played, result refers to results.id
+//
+// Classes, modes and card ids are dictionary encoded, ids and
+// timestamps delta encoded. Results are read from the store one by one
+// and written out every rowGroupSize rows, so memory use does not grow
+// with the size of the history.
+class ResultExporter
+{
+private:
+  ResultStore *mStore;
+  int mRowGroupSize;
+  int mExportedResults;
+  int mExportedCards;
+
+public:
+  ResultExporter( ResultStore *store, int rowGroupSize = RESULT_EXPORT_ROW_GROUP_SIZE );
+
+  // Existing exports in the directory are replaced
+  bool Export( const QString& directory );
+
+  int ExportedResults() const;
+  int ExportedCards() const;
+};
@@ -0,0 +1,272 @@
+#include "ResultJournal.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QVector>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define JOURNAL_MAGIC "TOBJ"
+#define JOURNAL_VERSION 1
+
+#define JOURNAL_RECORD_RESULT 1
+#define JOURNAL_RECORD_ACK 2
+
+// Header: magic (4), version (4)
+// Record: type (1), id (8), payload size (4), payload, crc32 of the former (4)
+#define JOURNAL_HEADER_SIZE 8
+#define JOURNAL_RECORD_OVERHEAD ( 1 + 8 + 4 + 4 )
+
+// Results are a few KB, anything larger is garbage
+#define JOURNAL_MAX_PAYLOAD_SIZE ( 16 * 1024 * 1024 )
+
+// fsync at most this often
+#define JOURNAL_SYNC_DELAY 1000
+
+// Compact when this many acks piled up and they outnumber the pending records
+#define JOURNAL_COMPACT_MIN_ACKS 32
+
+ResultJournal::ResultJournal( const QString& path, QObject *parent )
+  : QObject( parent ), mPath( path ), mFile( path ), mNextId( 1 ), mNumAcked( 0 )
+{
+  mSyncTimer = new QTimer( this );
+  mSyncTimer->setSingleShot( true );
+  mSyncTimer->setInterval( JOURNAL_SYNC_DELAY );
+  connect( mSyncTimer, &QTimer::timeout, this, &ResultJournal::Sync );
+
+  QDir().mkpath( QFileInfo( path ).absolutePath() );
+
+  if( !Replay() ) {
+    ERR( "Could not open result journal %s", qt2cstr( path ) );
+  }
+}
+
+ResultJournal::~ResultJournal() {
+  Flush();
+}
+
+const QMap< quint64, QJsonObject >& ResultJournal::Pending() const {
+  return mPending;
+}
+
+static QByteArray EncodeHeader() {
+  QByteArray header( JOURNAL_MAGIC );
+  header.resize( JOURNAL_HEADER_SIZE );
+  qToLittleEndian< quint32 >( JOURNAL_VERSION, reinterpret_cast< uchar* >( header.data() + 4 ) );
+  return header;
+}
+
+// Read all intact records, drop a torn tail
+bool ResultJournal::Replay() {
+  if( !mFile.open( QIODevice::ReadWrite ) )
+    return false;
+
+  QByteArray data = mFile.readAll();
+  qint64 validSize = JOURNAL_HEADER_SIZE;
+
+  if( data.size() < JOURNAL_HEADER_SIZE || !data.startsWith( JOURNAL_MAGIC ) ) {
+    // Empty, or the header of a new journal was torn: nothing to lose
+    if( EncodeHeader().startsWith( data ) )
+      return Rewrite();
+
+    ERR( "Result journal has no valid header" );
+    return MoveAside();
+  }
+
+  // Written by a newer version (downgrade): its results are not ours to drop
+  quint32 version = qFromLittleEndian< quint32 >( reinterpret_cast< const uchar* >( data.constData() + 4 ) );
+  if( version != JOURNAL_VERSION ) {
+    ERR( "Unknown result journal version %d", version );
+    return MoveAside();
+  }
+
+  const char *ptr = data.constData();
+  qint64 offset = JOURNAL_HEADER_SIZE;
+  while( offset + JOURNAL_RECORD_OVERHEAD <= data.size() ) {
+    const uchar *record = reinterpret_cast< const uchar* >( ptr + offset );
+    quint8 type = record[ 0 ];
+    quint64 id = qFromLittleEndian< quint64 >( record + 1 );
+    quint32 size = qFromLittleEndian< quint32 >( record + 9 );
+
+    if( size > JOURNAL_MAX_PAYLOAD_SIZE || offset + JOURNAL_RECORD_OVERHEAD + size > data.size() )
+      break;
+
+    quint32 crc = qFromLittleEndian< quint32 >( record + 13 + size );
+    if( crc != Checksum( ptr + offset, 13 + size ) )
+      break;
+
+    if( type == JOURNAL_RECORD_RESULT ) {
+      QByteArray payload( ptr + offset + 13, size );
+      mPending[ id ] = QJsonDocument::fromJson( payload ).object();
+    } else if( type == JOURNAL_RECORD_ACK ) {
+      mPending.remove( id );
+      mNumAcked++;
+    }
+    mNextId = qMax( mNextId, id + 1 );
+
+    offset += JOURNAL_RECORD_OVERHEAD + size;
+    validSize = offset;
+  }
+
+  if( validSize < data.size() ) {
+    ERR( "Result journal: dropped %d bytes of incomplete records", int( data.size() - validSize ) );
+    mFile.resize( validSize );
+  }
+  mFile.seek( validSize );
+
+  if( !mPending.isEmpty() ) {
+    LOG( "%d unsaved results found", mPending.size() );
+  }
+
+  MaybeCompact();
+  return true;
+}
+
+static QByteArray EncodeRecord( quint8 type, quint64 id, const QByteArray& payload ) {
+  QByteArray record( JOURNAL_RECORD_OVERHEAD + payload.size(), 0 );
+  uchar *ptr = reinterpret_cast< uchar* >( record.data() );
+  ptr[ 0 ] = type;
+  qToLittleEndian< quint64 >( id, ptr + 1 );
+  qToLittleEndian< quint32 >( payload.size(), ptr + 9 );
+  memcpy( ptr + 13, payload.constData(), payload.size() );
+  qToLittleEndian< quint32 >( ResultJournal::Checksum( record.constData(), 13 + payload.size() ), ptr + 13 + payload.size() );
+  return record;
+}
+
+bool ResultJournal::WriteRecord( quint8 type, quint64 id, const QByteArray& payload ) {
+  if( !mFile.isOpen() )
+    return false;
+
+  // One write per record, handed to the OS immediately
+  QByteArray record = EncodeRecord( type, id, payload );
+  if( mFile.write( record ) != record.size() || !mFile.flush() ) {
+    ERR( "Could not write to result journal: %s", qt2cstr( mFile.errorString() ) );
+    return false;
+  }
+
+  ScheduleSync();
+  return true;
+}
+
+quint64 ResultJournal::Append( const QJsonObject& result ) {
+  quint64 id = mNextId++;
+  mPending[ id ] = result;
+  WriteRecord( JOURNAL_RECORD_RESULT, id, QJsonDocument( result ).toJson( QJsonDocument::Compact ) );
+  return id;
+}
+
+void ResultJournal::Ack( quint64 id ) {
+  if( !mPending.remove( id ) )
+    return;
+
+  WriteRecord( JOURNAL_RECORD_ACK, id, QByteArray() );
+  mNumAcked++;
+  MaybeCompact();
+}
+
+void ResultJournal::MaybeCompact() {
+  if( mNumAcked == 0 )
+    return;
+
+  if( mPending.isEmpty() || ( mNumAcked >= JOURNAL_COMPACT_MIN_ACKS && mNumAcked >= mPending.size() ) ) {
+    Rewrite();
+  }
+}
+
+// Replace the journal with the pending records only
+// Written to a temporary file first, so a crash leaves either version intact
+bool ResultJournal::Rewrite() {
+  QSaveFile file( mPath );
+  if( !file.open( QIODevice::WriteOnly ) )
+    return false;
+
+  file.write( EncodeHeader() );
+  for( auto it = mPending.constBegin(); it != mPending.constEnd(); ++it ) {
+    file.write( EncodeRecord( JOURNAL_RECORD_RESULT, it.key(),
+          QJsonDocument( it.value() ).toJson( QJsonDocument::Compact ) ) );
+  }
+
+  // QSaveFile replaces the journal on commit
+  mFile.close();
+  bool committed = file.commit();
+  if( !committed ) {
+    ERR( "Could not compact result journal: %s", qt2cstr( file.errorString() ) );
+  }
+
+  mNumAcked = 0;
+  if( !mFile.open( QIODevice::ReadWrite | QIODevice::Append ) )
+    return false;
+
+  return committed;
+}
+
+// Keep a journal we cannot read next to the new one, for a newer
+// version or by hand, instead of starting over on top of it
+bool ResultJournal::MoveAside() {
+  mFile.close();
+
+  QString backup = mPath + ".bak";
+  for( int n = 1; QFile::exists( backup ); n++ ) {
+    backup = QString( "%1.bak.%2" ).arg( mPath ).arg( n );
+  }
+
+  if( !QFile::rename( mPath, backup ) ) {
+    ERR( "Could not move the result journal aside, leaving it alone" );
+    return false;
+  }
+
+  LOG( "Result journal moved to %s", qt2cstr( backup ) );
+  return Rewrite();
+}
+
+void ResultJournal::ScheduleSync() {
+  if( !mSyncTimer->isActive() )
+    mSyncTimer->start();
+}
+
+void ResultJournal::Sync() {
+  if( !mFile.isOpen() )
+    return;
+
+  mFile.flush();
+#ifdef Q_OS_WIN
+  _commit( mFile.handle() );
+#else
+  fsync( mFile.handle() );
+#endif
+}
+
+void ResultJournal::Flush() {
+  mSyncTimer->stop();
+  Sync();
+}
+
+// CRC-32 (IEEE)
+static QVector< quint32 > CrcTable() {
+  QVector< quint32 > table( 256 );
+  for( quint32 i = 0; i < 256; i++ ) {
+    quint32 c = i;
+    for( int k = 0; k < 8; k++ ) {
+      c = ( c & 1 ) ? ( 0xEDB88320 ^ ( c >> 1 ) ) : ( c >> 1 );
+    }
+    table[ i ] = c;
+  }
+  return table;
+}
+
+quint32 ResultJournal::Checksum( const char *data, int size ) {
+  static const QVector< quint32 > table = CrcTable();
+
+  quint32 crc = 0xFFFFFFFF;
+  for( int i = 0; i < size; i++ ) {
+    crc = table[ ( crc ^ quint8( data[ i ] ) ) & 0xFF ] ^ ( crc >> 8 );
+  }
+  return crc ^ 0xFFFFFFFF;
+}
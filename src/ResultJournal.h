@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QMap>
+#include <QTimer>
+#include <QJsonObject>
+
+// Append-only journal of results which still have to be uploaded
+//
+// Every result is appended as a record when it is queued and an ack
+// record is appended once it was uploaded. Records carry a CRC32, so a
+// torn write at the end of the file (crash, power loss) is detected and
+// dropped when the journal is opened. A journal of an unknown version is
+// moved aside (.bak), never truncated.
+//
+// Writes reach the OS right away (so killing the process loses nothing),
+// fsync is batched. Once everything is acknowledged (or enough acks pile
+// up) the journal is compacted to the pending records.
+class ResultJournal : public QObject
+{
+  Q_OBJECT
+
+private:
+  QString mPath;
+  QFile   mFile;
+  QTimer *mSyncTimer;
+
+  QMap< quint64, QJsonObject > mPending; // by id, in order of appending
+  quint64 mNextId;
+  int     mNumAcked; // ack records since the last compaction
+
+  bool Replay();
+  bool WriteRecord( quint8 type, quint64 id, const QByteArray& payload );
+  bool Rewrite();
+  bool MoveAside();
+  void MaybeCompact();
+  void ScheduleSync();
+
+private slots:
+  void Sync();
+
+public:
+  ResultJournal( const QString& path, QObject *parent = 0 );
+  ~ResultJournal();
+
+  // Results not acknowledged yet, oldest first
+  const QMap< quint64, QJsonObject >& Pending() const;
+
+  // Returns the id to acknowledge the result with
+  quint64 Append( const QJsonObject& result );
+  void Ack( quint64 id );
+
+  // Force pending writes to disk
+  void Flush();
+
+  static quint32 Checksum( const char *data, int size );
+};
@@ -1,41 +1,99 @@
 #include "ResultQueue.h"
 
-#define RESULT_QUEUE_UPLOAD_PERIOD (60 * 1000)
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QCryptographicHash>
 
-ResultQueue::ResultQueue()
+#include <random>
+
+#define RESULT_QUEUE_JOURNAL "results.journal"
+#define RESULT_QUEUE_DEAD_LETTERS "results.rejected"
+
+// Results per bulk upload request
+#define RESULT_QUEUE_BATCH_SIZE 25
+
+// Requests at the same time, by default
+#define RESULT_QUEUE_MAX_IN_FLIGHT 4
+
+// Retry after 5 s, 10 s, 20 s, ... up to one hour (each with jitter)
+#define RESULT_QUEUE_BACKOFF_BASE (5 * 1000)
+#define RESULT_QUEUE_BACKOFF_MAX (60 * 60 * 1000)
+
+ResultQueue::ResultQueue( const QString& journalPath )
+  : mInFlight( 0 ), mMaxInFlight( RESULT_QUEUE_MAX_IN_FLIGHT ), mFailures( 0 ),
+    mBackoffBase( RESULT_QUEUE_BACKOFF_BASE ), mBackoffMax( RESULT_QUEUE_BACKOFF_MAX ),
+    mBulkUploadSupported( true ), mDrainUploaded( 0 ), mDrainTotal( 0 )
 {
   connect( &mWebProfile, &WebProfile::UploadResultFailed, this, &ResultQueue::UploadResultFailed );
   connect( &mWebProfile, &WebProfile::UploadResultSucceeded, this, &ResultQueue::UploadResultSucceeded );
+  connect( &mWebProfile, &WebProfile::UploadResultsFailed, this, &ResultQueue::UploadResultsFailed );
+  connect( &mWebProfile, &WebProfile::UploadResultsSucceeded, this, &ResultQueue::UploadResultsSucceeded );
 
   mUploadTimer = new QTimer( this );
+  mUploadTimer->setSingleShot( true );
   connect( mUploadTimer, &QTimer::timeout, this, &ResultQueue::UploadQueue );
 
+  QString path = journalPath;
+  if( path.isEmpty() ) {
+    path = QStandardPaths::writableLocation( QStandardPaths::DataLocation ) + "/" RESULT_QUEUE_JOURNAL;
+  }
+  mJournal = new ResultJournal( path, this );
+  mDeadLetters = new ResultJournal( QFileInfo( path ).absolutePath() + "/" RESULT_QUEUE_DEAD_LETTERS, this );
+
   Load();
 }
 
 ResultQueue::~ResultQueue() {
-  Save();
+  mJournal->Flush();
 }
 
 void ResultQueue::Load() {
+  MigrateSettingsQueue();
+
+  // Copy, acking duplicates changes the journal's view
+  QMap< quint64, QJsonObject > pending = mJournal->Pending();
+  for( auto it = pending.constBegin(); it != pending.constEnd(); ++it ) {
+    QJsonObject result = it.value();
+    QString clientId = ClientId( result );
+    if( IsDuplicate( clientId ) ) {
+      LOG( "Drop duplicate of queued result %s", qt2cstr( clientId ) );
+      mJournal->Ack( it.key() );
+      UploadStats::Instance()->RecordDuplicate();
+      continue;
+    }
+
+    result[ "client_id" ] = clientId;
+    QueuedResult queued = { it.key(), clientId, result, false, false, 0 };
+    mQueue << queued;
+  }
+  UploadStats::Instance()->RecordBacklog( mQueue.size() );
+
+  // Give the network (and account) a moment after launch
+  if( !mQueue.isEmpty() ) {
+    mUploadTimer->start( mBackoffBase );
+  }
+}
+
+// Older versions kept the queue as one blob in the settings
+void ResultQueue::MigrateSettingsQueue() {
   QSettings settings;
   if( settings.contains( "resultsQueue" ) ) {
     QJsonDocument doc = QJsonDocument::fromJson(
         settings.value( "resultsQueue" ).toByteArray() );
-    mQueue = doc.array();
-    if( mQueue.size() > 0 ) {
-      LOG( "%d unsaved results found", mQueue.size() );
+    QJsonArray queue = doc.array();
+    if( queue.size() > 0 ) {
+      LOG( "%d unsaved results found in settings", queue.size() );
     }
 
+    for( const QJsonValue& result : queue ) {
+      mJournal->Append( result.toObject() );
+    }
+    mJournal->Flush();
+
     settings.remove( "resultsQueue" );
   }
 }
 
-void ResultQueue::Save() {
-  LOG( "Saving %d results", mQueue.size() );
-  QSettings().setValue( "resultsQueue", QJsonDocument( mQueue ).toJson() );
-}
-
 void ResultQueue::Add( const Result& res ) {
   if( res.mode == MODE_SOLO_ADVENTURES ) {
     LOG( "Ignore solo adventure" );
@@ -94,39 +152,326 @@ void ResultQueue::Add( const Result& res ) {
       CLASS_NAMES[ res.hero ],
       ORDER_NAMES[ res.order ] );
 
-  // Try to upload immediately
-  UploadResult( res.AsJson() );
+  QJsonObject json = res.AsJson();
+  QString clientId = ClientId( json );
+  if( IsDuplicate( clientId ) ) {
+    LOG( "Result was queued before. Skip result" );
+    UploadStats::Instance()->RecordDuplicate();
+    return;
+  }
+
+  // Journal first, so the result survives a crash during the upload
+  QueuedResult queued = { mJournal->Append( json ), clientId, json, false, false, QDateTime::currentMSecsSinceEpoch() };
+  mQueue << queued;
+  UploadStats::Instance()->RecordQueued( mQueue.size() );
+  emit ResultQueued( res );
+  if( mDrainTotal > 0 ) {
+    mDrainTotal++;
+  }
+
+  // Try to upload immediately, unless the server asked us to back off
+  if( mFailures == 0 ) {
+    UploadQueue();
+  } else {
+    LOG( "Upload backed off, will try again later" );
+  }
+}
+
+void ResultQueue::SetBackoff( int baseMs, int maxMs ) {
+  mBackoffBase = baseMs;
+  mBackoffMax = maxMs;
+
+  if( mUploadTimer->isActive() ) {
+    mUploadTimer->start( qMin( mUploadTimer->remainingTime(), BackoffDelay() ) );
+  }
+}
+
+void ResultQueue::Prewarm() {
+  mWebProfile.Prewarm();
 }
 
-void ResultQueue::UploadResult( const QJsonObject& result ) {
+int ResultQueue::Size() const {
+  return mQueue.size();
+}
+
+int ResultQueue::DeadLetterCount() const {
+  return mDeadLetters->Pending().size();
+}
+
+int ResultQueue::NumWaiting() const {
+  int count = 0;
+  for( const QueuedResult& queued : mQueue ) {
+    if( !queued.uploading )
+      count++;
+  }
+  return count;
+}
+
+int ResultQueue::FindUploading( const QJsonObject& result ) const {
+  QString clientId = ClientId( result );
+  for( int i = 0; i < mQueue.size(); i++ ) {
+    if( mQueue[ i ].uploading && mQueue[ i ].clientId == clientId )
+      return i;
+  }
+  return -1;
+}
+
+bool ResultQueue::IsDuplicate( const QString& clientId ) const {
+  if( mUploadedIds.contains( clientId ) )
+    return true;
+
+  for( const QueuedResult& queued : mQueue ) {
+    if( queued.clientId == clientId )
+      return true;
+  }
+  return false;
+}
+
+QString ResultQueue::ClientId( const QJsonObject& result ) {
+  QString clientId = result[ "client_id" ].toString();
+  if( clientId.isEmpty() ) {
+    QByteArray json = QJsonDocument( result ).toJson( QJsonDocument::Compact );
+    clientId = QString::fromLatin1( QCryptographicHash::hash( json, QCryptographicHash::Sha1 ).toHex() );
+  }
+  return clientId;
+}
+
+void ResultQueue::SetMaxInFlight( int maxInFlight ) {
+  mMaxInFlight = qMax( maxInFlight, 1 );
+}
+
+// Fill the window with the oldest waiting results. Results that failed
+// are back to waiting at their old position, so they go out again
+// before anything newer
+void ResultQueue::UploadQueue() {
+  while( mInFlight < mMaxInFlight && NumWaiting() > 0 ) {
+    if( mDrainTotal == 0 && NumWaiting() > 1 ) {
+      mDrainUploaded = 0;
+      mDrainTotal = NumWaiting();
+    }
+
+    QueuedResult *oldest = NULL;
+    for( QueuedResult& queued : mQueue ) {
+      if( !queued.uploading ) {
+        oldest = &queued;
+        break;
+      }
+    }
+
+    if( mBulkUploadSupported && !oldest->single && NumWaiting() > 1 ) {
+      UploadBatch();
+    } else {
+      UploadResult( *oldest );
+    }
+  }
+}
+
+void ResultQueue::UploadResult( QueuedResult& queued ) {
   LOG( "Uploading result..." );
-  mWebProfile.UploadResult( result );
+  queued.uploading = true;
+  mInFlight++;
+  mWebProfile.UploadResult( queued.result );
 }
 
-void ResultQueue::UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode ) {
+void ResultQueue::UploadBatch() {
+  QJsonArray batch;
+  for( QueuedResult& queued : mQueue ) {
+    if( batch.size() >= RESULT_QUEUE_BATCH_SIZE )
+      break;
+
+    if( !queued.uploading && !queued.single ) {
+      queued.uploading = true;
+      batch.append( queued.result );
+    }
+  }
+
+  LOG( "Uploading %d old results...", batch.size() );
+  mInFlight++;
+  mWebProfile.UploadResults( batch );
+}
+
+// 4xx means the server will never take this result; anything else
+// (network errors, 5xx, throttling, auth trouble) is worth another try
+bool ResultQueue::IsRejection( int replyCode, int httpStatusCode ) {
+  UNUSED_ARG( replyCode );
+
+  return httpStatusCode >= 400 && httpStatusCode < 500 &&
+    httpStatusCode != 401 && httpStatusCode != 403 &&
+    httpStatusCode != 408 && httpStatusCode != 429;
+}
+
+// Exponential backoff with jitter, somewhere between half and the full delay
+// so clients do not come back all at once after an outage
+int ResultQueue::BackoffDelay() const {
+  static std::mt19937 random( std::random_device{}() );
+
+  qint64 delay = mBackoffBase;
+  for( int i = 1; i < mFailures && delay < mBackoffMax; i++ ) {
+    delay *= 2;
+  }
+  delay = qMin( delay, qint64( mBackoffMax ) );
+
+  std::uniform_int_distribution< qint64 > jitter( delay / 2, delay );
+  return int( jitter( random ) );
+}
+
+void ResultQueue::RetryLater( int retryAfter ) {
+  mFailures++;
+  mDrainTotal = 0;
+  UploadStats::Instance()->RecordRetry();
+
+  int delay = retryAfter > 0 ? qMin( retryAfter, mBackoffMax ) : BackoffDelay();
+  LOG( "Will try to upload %d results again in %d s", mQueue.size(), delay / 1000 );
+
+  // Keep an earlier retry if there is one
+  if( !mUploadTimer->isActive() || mUploadTimer->remainingTime() > delay ) {
+    mUploadTimer->start( delay );
+  }
+}
+
+void ResultQueue::Accept( int idx, int id ) {
+  qint64 queued = mQueue[ idx ].queued;
+  mUploadedIds.insert( mQueue[ idx ].clientId );
+  mJournal->Ack( mQueue[ idx ].id );
+  mQueue.removeAt( idx );
+  mDrainUploaded++;
+  UploadStats::Instance()->RecordUploaded( queued ? QDateTime::currentMSecsSinceEpoch() - queued : -1, mQueue.size() );
+  emit ResultUploaded( id );
+}
+
+void ResultQueue::DeadLetter( int idx, const QString& reason ) {
+  ERR( "Result was rejected by the server (%s). Keep it aside, no more retries", qt2cstr( reason ) );
+
+  mDeadLetters->Append( mQueue[ idx ].result );
+  mDeadLetters->Flush();
+  mJournal->Ack( mQueue[ idx ].id );
+  mQueue.removeAt( idx );
+  UploadStats::Instance()->RecordRejected( mQueue.size() );
+}
+
+// A request finished without errors: keep going
+void ResultQueue::UploadFinished() {
+  if( mDrainTotal > 0 ) {
+    LOG( "Uploaded %d of %d old results", mDrainUploaded, mDrainTotal );
+    emit UploadProgress( mDrainUploaded, mDrainTotal );
+  }
+
+  if( mQueue.isEmpty() ) {
+    mDrainTotal = 0;
+  }
+
+  // Another request of the window failed and is waiting for its retry:
+  // sending newer results now would overtake it
+  if( mUploadTimer->isActive() )
+    return;
+
+  mFailures = 0;
+
+  if( NumWaiting() > 0 ) {
+    UploadQueue();
+  }
+}
+
+// Like UploadFinished, the retry timer picks these results up otherwise
+void ResultQueue::UploadNowUnlessRetrying() {
+  if( !mUploadTimer->isActive() ) {
+    UploadQueue();
+  }
+}
+
+void ResultQueue::UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode, int retryAfter ) {
+  mInFlight--;
+
+  int idx = FindUploading( result );
+  if( idx < 0 )
+    return;
+
+  // Stored by an earlier attempt whose reply got lost
+  if( httpStatusCode == 409 ) {
+    LOG( "Result was uploaded before" );
+    Accept( idx, 0 );
+    UploadFinished();
+    return;
+  }
+
+  if( IsRejection( replyCode, httpStatusCode ) ) {
+    DeadLetter( idx, QString( "HTTP %1" ).arg( httpStatusCode ) );
+    UploadFinished();
+    return;
+  }
+
   ERR( "There was a problem uploading the result (Reply %d, HTTP %d). Will save the result locally and try again later.", replyCode, httpStatusCode );
-  mQueue.append( result );
 
-  // Upload not working
-  mUploadTimer->stop();
+  // Already in the journal, just retry later
+  mQueue[ idx ].uploading = false;
+  RetryLater( retryAfter );
 }
 
-void ResultQueue::UploadResultSucceeded( const QJsonObject& response ) {
+void ResultQueue::UploadResultSucceeded( const QJsonObject& result, const QJsonObject& response ) {
+  mInFlight--;
+
   int id = response[ "result" ].toObject()[ "id" ].toInt();
-  if( id ) {
-    emit ResultUploaded( id );
-  } else {
+  if( !id ) {
     ERR( "Response without id received" );
   }
 
-  // If we have items in the queue, it's time to slowly roll them out
-  mUploadTimer->start( RESULT_QUEUE_UPLOAD_PERIOD );
+  int idx = FindUploading( result );
+  if( idx >= 0 ) {
+    Accept( idx, id );
+  }
+
+  UploadFinished();
 }
 
-void ResultQueue::UploadQueue() {
-  if( !mQueue.isEmpty() ) {
-    LOG( "Uploading an old result..." );
-    QJsonObject result = mQueue.takeAt( 0 ).toObject();
-    UploadResult( result );
+void ResultQueue::UploadResultsFailed( const QJsonArray& results, int replyCode, int httpStatusCode, int retryAfter ) {
+  mInFlight--;
+
+  bool rejected = IsRejection( replyCode, httpStatusCode );
+  for( const QJsonValue& result : results ) {
+    int idx = FindUploading( result.toObject() );
+    if( idx >= 0 ) {
+      mQueue[ idx ].uploading = false;
+      mQueue[ idx ].single = rejected;
+    }
+  }
+
+  if( httpStatusCode == 404 ) {
+    // Older server, fall back to one result at a time
+    LOG( "Bulk upload not supported by the server" );
+    mBulkUploadSupported = false;
+    UploadNowUnlessRetrying();
+    return;
+  }
+
+  if( rejected ) {
+    // The server would not take the batch as a whole (one bad result, too
+    // large, ...): one at a time, so only what it rejects is dead-lettered
+    LOG( "Batch of %d results was rejected (HTTP %d), uploading them one by one", results.size(), httpStatusCode );
+    UploadNowUnlessRetrying();
+    return;
   }
+
+  ERR( "There was a problem uploading %d results (Reply %d, HTTP %d). Will try again later.", results.size(), replyCode, httpStatusCode );
+  RetryLater( retryAfter );
+}
+
+void ResultQueue::UploadResultsSucceeded( const QJsonArray& results, const QJsonArray& acks ) {
+  mInFlight--;
+
+  for( int i = 0; i < results.size(); i++ ) {
+    int idx = FindUploading( results[ i ].toObject() );
+    if( idx < 0 )
+      continue;
+
+    // Only an explicit error is a rejection, like for single uploads an ack
+    // without id (e.g. { "duplicate": true } for a known client_id) is stored
+    QJsonObject ack = acks[ i ].toObject();
+    if( ack.contains( "error" ) ) {
+      DeadLetter( idx, ack[ "error" ].toString() );
+    } else {
+      Accept( idx, ack[ "id" ].toInt() );
+    }
+  }
+
+  UploadFinished();
 }
@@ -2,9 +2,12 @@
 
 #include "Result.h"
 #include "WebProfile.h"
+#include "ResultJournal.h"
+#include "UploadStats.h"
 
 #include <QTimer>
 #include <QSettings>
+#include <QSet>
 
 #include <QJsonDocument>
 #include <QJsonArray>
@@ -15,27 +18,85 @@ class ResultQueue : public QObject
   Q_OBJECT
 
 private:
-  QTimer*     mUploadTimer;
-  QJsonArray  mQueue;
+  typedef struct {
+    quint64     id; // in the journal
+    QString     clientId;
+    QJsonObject result;
+    bool        uploading;
+    bool        single; // part of a rejected batch, goes out on its own
+    qint64      queued; // ms since epoch, 0 if queued in an earlier session
+  } QueuedResult;
+
+  QTimer*     mUploadTimer; // next attempt, immediate or backed off
+  QList< QueuedResult > mQueue;
   WebProfile  mWebProfile;
+  ResultJournal *mJournal;
+  ResultJournal *mDeadLetters; // rejected by the server, kept for inspection
+  QSet< QString > mUploadedIds; // this session
+
+  int         mInFlight;   // requests
+  int         mMaxInFlight;
+  int         mFailures;   // in a row
+  int         mBackoffBase;
+  int         mBackoffMax;
+
+  // Backlog is sent in batches, until the server says it can't
+  bool        mBulkUploadSupported;
+  int         mDrainUploaded;
+  int         mDrainTotal;
 
   void Load();
-  void Save();
+  void MigrateSettingsQueue();
+
+  void UploadResult( QueuedResult& queued );
+  void UploadBatch();
+  int FindUploading( const QJsonObject& result ) const;
+  bool IsDuplicate( const QString& clientId ) const;
+  int NumWaiting() const;
+
+  void Accept( int idx, int id );
+  void DeadLetter( int idx, const QString& reason );
+  void RetryLater( int retryAfter );
+  void UploadFinished();
+  void UploadNowUnlessRetrying();
+  int BackoffDelay() const;
 
-  void UploadResult( const QJsonObject& result );
+  static bool IsRejection( int replyCode, int httpStatusCode );
 
 private slots:
-  void UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode );
-  void UploadResultSucceeded( const QJsonObject& response );
+  void UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode, int retryAfter );
+  void UploadResultSucceeded( const QJsonObject& result, const QJsonObject& response );
+  void UploadResultsFailed( const QJsonArray& results, int replyCode, int httpStatusCode, int retryAfter );
+  void UploadResultsSucceeded( const QJsonArray& results, const QJsonArray& acks );
 
   void UploadQueue();
 
 signals:
+  // Passed the checks and is queued for upload
+  void ResultQueued( const Result& result );
   void ResultUploaded( int id );
+  void UploadProgress( int uploaded, int total );
 
 public:
-  ResultQueue();
+  ResultQueue( const QString& journalPath = QString() );
   ~ResultQueue();
 
   void Add( const Result& result );
+
+  // A result is on its way: have a connection ready by the time it is
+  void Prewarm();
+
+  // Results not uploaded yet
+  int Size() const;
+  int DeadLetterCount() const;
+
+  // client_id of the result, results queued by older versions get one from their content
+  static QString ClientId( const QJsonObject& result );
+
+  // Requests sent without waiting for a reply, 1 uploads strictly in order
+  void SetMaxInFlight( int maxInFlight );
+
+  // Delay of the first retry (doubling up to maxMs), also used before
+  // uploading what is left from the last session
+  void SetBackoff( int baseMs, int maxMs );
 };
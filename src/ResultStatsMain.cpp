@@ -0,0 +1,115 @@
+#include "ResultStore.h"
+#include "ResultExporter.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+static int ParseEnum( const QString& name, const char names[][128], int count ) {
+  for( int i = 0; i < count; i++ ) {
+    if( name == names[ i ] )
+      return i;
+  }
+  return -1;
+}
+
+static void PrintWinLoss( const char *label, const WinLoss& winLoss ) {
+  printf( "  %-20s %5.1f%% %6d games\n", label, Winrate( winLoss ) * 100.0f, winLoss.games );
+}
+
+int main( int argc, char **argv )
+{
+  QCoreApplication app( argc, argv );
+  app.setApplicationName( "Track-o-Bot" ); // same DataLocation as the app
+  app.setOrganizationName( "spidy.ch" );
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription( "Winrates from the local Track-o-Bot result store" );
+  parser.addHelpOption();
+  parser.addOption( QCommandLineOption( "store", "Result store to read", "path" ) );
+  parser.addOption( QCommandLineOption( "mode", "ranked, casual, arena or friendly", "mode" ) );
+  parser.addOption( QCommandLineOption( "hero", "Own class", "class" ) );
+  parser.addOption( QCommandLineOption( "opponent", "Class of the opponent", "class" ) );
+  parser.addOption( QCommandLineOption( "since", "First day (YYYY-MM-DD)", "date" ) );
+  parser.addOption( QCommandLineOption( "until", "Last day (YYYY-MM-DD)", "date" ) );
+  parser.addOption( QCommandLineOption( "band", "Ranks per rank band", "size", "5" ) );
+  parser.addOption( QCommandLineOption( "export", "Write all results as Parquet files to the directory instead", "directory" ) );
+  parser.process( app );
+
+  ResultFilter filter;
+  if( parser.isSet( "mode" ) ) {
+    filter.mode = static_cast< GameMode >( ParseEnum( parser.value( "mode" ), MODE_NAMES, MODE_UNKNOWN ) );
+  }
+  if( parser.isSet( "hero" ) ) {
+    filter.hero = static_cast< HeroClass >( ParseEnum( parser.value( "hero" ), CLASS_NAMES, NUM_CLASSES ) );
+  }
+  if( parser.isSet( "opponent" ) ) {
+    filter.opponent = static_cast< HeroClass >( ParseEnum( parser.value( "opponent" ), CLASS_NAMES, NUM_CLASSES ) );
+  }
+  if( filter.mode < 0 || filter.hero < 0 || filter.opponent < 0 ) {
+    fprintf( stderr, "Unknown mode or class\n" );
+    return 1;
+  }
+  if( parser.isSet( "since" ) ) {
+    filter.from = QDateTime( QDate::fromString( parser.value( "since" ), Qt::ISODate ) );
+  }
+  if( parser.isSet( "until" ) ) {
+    filter.to = QDateTime( QDate::fromString( parser.value( "until" ), Qt::ISODate ).addDays( 1 ) ).addMSecs( -1 );
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  ResultStore store( parser.value( "store" ), ResultStore::READ_ONLY );
+  if( !store.IsOpen() ) {
+    fprintf( stderr, "Could not read the result store %s\n", qt2cstr( store.Path() ) );
+    return 1;
+  }
+  printf( "%d results loaded in %lld ms\n", store.Size(), timer.elapsed() );
+
+  if( parser.isSet( "export" ) ) {
+    timer.restart();
+    ResultExporter exporter( &store );
+    if( !exporter.Export( parser.value( "export" ) ) ) {
+      fprintf( stderr, "Export failed\n" );
+      return 1;
+    }
+    printf( "%d results and %d cards exported in %lld ms\n", exporter.ExportedResults(), exporter.ExportedCards(), timer.elapsed() );
+    return 0;
+  }
+
+  timer.restart();
+  WinLoss total = store.Total( filter );
+  QVector< WinLoss > orders = store.ByOrder( filter );
+  QVector< WinLoss > matchups = store.ByMatchup( filter );
+  QMap< int, WinLoss > bands = store.ByRankBand( filter, parser.value( "band" ).toInt() );
+  qint64 queryTime = timer.nsecsElapsed() / 1000;
+
+  printf( "\nOverall\n" );
+  PrintWinLoss( "all", total );
+  PrintWinLoss( "going first", orders[ ORDER_FIRST ] );
+  PrintWinLoss( "going second", orders[ ORDER_SECOND ] );
+
+  printf( "\nMatchups\n" );
+  for( int hero = 0; hero < NUM_CLASSES; hero++ ) {
+    for( int opponent = 0; opponent < NUM_CLASSES; opponent++ ) {
+      const WinLoss& matchup = matchups[ hero * NUM_CLASSES + opponent ];
+      if( matchup.games ) {
+        QByteArray label = QByteArray( CLASS_NAMES[ hero ] ) + " vs " + CLASS_NAMES[ opponent ];
+        PrintWinLoss( label.constData(), matchup );
+      }
+    }
+  }
+
+  if( !bands.isEmpty() ) {
+    printf( "\nRank bands\n" );
+    int bandSize = qMax( parser.value( "band" ).toInt(), 1 );
+    for( auto it = bands.constBegin(); it != bands.constEnd(); ++it ) {
+      QByteArray label = it.key() == 0 ? QByteArray( "legend" ) :
+        "rank " + QByteArray::number( it.key() ) + "-" + QByteArray::number( it.key() + bandSize - 1 );
+      PrintWinLoss( label.constData(), it.value() );
+    }
+  }
+
+  printf( "\nQueries took %lld us\n", queryTime );
+  return 0;
+}
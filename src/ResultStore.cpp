@@ -0,0 +1,376 @@
+#include "ResultStore.h"
+#include "ResultJournal.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <algorithm>
+
+#define STORE_FILE "results.store"
+
+#define STORE_MAGIC "TOBS"
+#define STORE_VERSION 1
+
+// Header: magic (4), version (4)
+// Record: json size (4), client id (20), added (8), legend (4), duration (4),
+//         mode, outcome, order, hero, opponent, rank (1 each), reserved (2),
+//         crc32 of the former (4), json, crc32 of the json (4)
+#define STORE_HEADER_SIZE 8
+#define STORE_ROW_SIZE 48
+#define STORE_RECORD_OVERHEAD ( STORE_ROW_SIZE + 4 + 4 )
+
+#define STORE_MAX_PAYLOAD_SIZE ( 16 * 1024 * 1024 )
+
+ResultStore::ResultStore( const QString& path, OpenMode mode, QObject *parent )
+  : QObject( parent ), mPath( path ), mMode( mode )
+{
+  if( mPath.isEmpty() ) {
+    mPath = QStandardPaths::writableLocation( QStandardPaths::DataLocation ) + "/" STORE_FILE;
+  }
+  mFile.setFileName( mPath );
+
+  if( mMode == READ_WRITE ) {
+    QDir().mkpath( QFileInfo( mPath ).absolutePath() );
+  }
+
+  if( !Load() ) {
+    ERR( "Could not open result store %s", qt2cstr( mPath ) );
+  }
+}
+
+ResultStore::~ResultStore() {
+}
+
+const QString& ResultStore::Path() const {
+  return mPath;
+}
+
+bool ResultStore::IsOpen() const {
+  return mFile.isOpen();
+}
+
+// Read the fixed part of all intact records, drop a torn tail
+bool ResultStore::Load() {
+  if( !mFile.open( mMode == READ_ONLY ? QIODevice::ReadOnly : QIODevice::ReadWrite ) )
+    return false;
+
+  qint64 fileSize = mFile.size();
+  if( fileSize == 0 ) {
+    if( mMode == READ_ONLY )
+      return true;
+
+    QByteArray header( STORE_MAGIC );
+    header.resize( STORE_HEADER_SIZE );
+    qToLittleEndian< quint32 >( STORE_VERSION, reinterpret_cast< uchar* >( header.data() + 4 ) );
+    return mFile.write( header ) == header.size() && mFile.flush();
+  }
+
+  // Unlike the upload journal this is the only copy of the history: never start over
+  QByteArray header = mFile.read( STORE_HEADER_SIZE );
+  if( header.size() < STORE_HEADER_SIZE || !header.startsWith( STORE_MAGIC ) ||
+      qFromLittleEndian< quint32 >( reinterpret_cast< const uchar* >( header.constData() + 4 ) ) != STORE_VERSION )
+  {
+    ERR( "Result store has an unknown format, leaving it alone" );
+    mFile.close();
+    return false;
+  }
+
+  QByteArray data;
+  const uchar *ptr = mFile.map( 0, fileSize );
+  if( !ptr ) {
+    mFile.seek( 0 );
+    data = mFile.readAll();
+    ptr = reinterpret_cast< const uchar* >( data.constData() );
+  }
+
+  qint64 offset = STORE_HEADER_SIZE;
+  while( offset + STORE_RECORD_OVERHEAD <= fileSize ) {
+    const uchar *row = ptr + offset;
+    quint32 size = qFromLittleEndian< quint32 >( row );
+    if( size > STORE_MAX_PAYLOAD_SIZE || offset + STORE_RECORD_OVERHEAD + size > fileSize )
+      break;
+
+    if( qFromLittleEndian< quint32 >( row + STORE_ROW_SIZE ) != ResultJournal::Checksum( reinterpret_cast< const char* >( row ), STORE_ROW_SIZE ) )
+      break;
+
+    StoredResult result;
+    result.added    = qFromLittleEndian< qint64 >( row + 24 );
+    result.offset   = offset + STORE_ROW_SIZE + 4;
+    result.size     = size;
+    result.legend   = qFromLittleEndian< quint32 >( row + 32 );
+    result.duration = qFromLittleEndian< quint32 >( row + 36 );
+    result.mode     = row[ 40 ];
+    result.outcome  = row[ 41 ];
+    result.order    = row[ 42 ];
+    result.hero     = row[ 43 ];
+    result.opponent = row[ 44 ];
+    result.rank     = row[ 45 ];
+
+    mClientIds.insert( QByteArray( reinterpret_cast< const char* >( row + 4 ), 20 ) );
+    Index( result );
+
+    offset += STORE_RECORD_OVERHEAD + size;
+  }
+
+  if( data.isEmpty() ) {
+    mFile.unmap( const_cast< uchar* >( ptr ) );
+  }
+
+  // Read only: probably the app is just appending, the tail is not ours to drop
+  if( offset < fileSize && mMode == READ_WRITE ) {
+    ERR( "Dropped %lld bytes of an incomplete result at the end of the result store", fileSize - offset );
+    mFile.resize( offset );
+  }
+  mFile.seek( offset );
+
+  LOG( "%d results in the local result store", mResults.size() );
+  return true;
+}
+
+void ResultStore::Index( const StoredResult& result ) {
+  int idx = mResults.size();
+  mResults << result;
+
+  if( result.hero < NUM_CLASSES )
+    mByHero[ result.hero ] << idx;
+  if( result.opponent < NUM_CLASSES )
+    mByOpponent[ result.opponent ] << idx;
+  if( result.mode < MODE_UNKNOWN )
+    mByMode[ result.mode ] << idx;
+  if( result.rank < 26 )
+    mByRank[ result.rank ] << idx;
+
+  // Results come in chronologically, so this is almost always an append
+  auto pos = std::upper_bound( mByDate.begin(), mByDate.end(), result.added, [this]( qint64 added, int i ) {
+    return added < mResults[ i ].added;
+  });
+  mByDate.insert( pos, idx );
+}
+
+void ResultStore::Add( const Result& res ) {
+  if( !mFile.isOpen() || mMode == READ_ONLY )
+    return;
+
+  QByteArray clientId = QByteArray::fromHex( res.Id().toLatin1() );
+  if( mClientIds.contains( clientId ) )
+    return;
+
+  QByteArray json = QJsonDocument( res.AsJson() ).toJson( QJsonDocument::Compact );
+
+  StoredResult result;
+  result.added    = res.added.toMSecsSinceEpoch();
+  result.offset   = mFile.pos() + STORE_ROW_SIZE + 4;
+  result.size     = json.size();
+  result.legend   = res.mode == MODE_RANKED ? res.legend : LEGEND_UNKNOWN;
+  result.duration = res.duration;
+  result.mode     = res.mode;
+  result.outcome  = res.outcome;
+  result.order    = res.order;
+  result.hero     = res.hero;
+  result.opponent = res.opponent;
+  result.rank     = res.mode == MODE_RANKED && result.legend == LEGEND_UNKNOWN ? res.rank : RANK_UNKNOWN;
+
+  QByteArray record( STORE_RECORD_OVERHEAD + json.size(), 0 );
+  uchar *row = reinterpret_cast< uchar* >( record.data() );
+  qToLittleEndian< quint32 >( result.size, row );
+  memcpy( row + 4, clientId.constData(), qMin( clientId.size(), 20 ) );
+  qToLittleEndian< qint64 >( result.added, row + 24 );
+  qToLittleEndian< quint32 >( result.legend, row + 32 );
+  qToLittleEndian< quint32 >( result.duration, row + 36 );
+  row[ 40 ] = result.mode;
+  row[ 41 ] = result.outcome;
+  row[ 42 ] = result.order;
+  row[ 43 ] = result.hero;
+  row[ 44 ] = result.opponent;
+  row[ 45 ] = result.rank;
+  qToLittleEndian< quint32 >( ResultJournal::Checksum( record.constData(), STORE_ROW_SIZE ), row + STORE_ROW_SIZE );
+  memcpy( row + STORE_ROW_SIZE + 4, json.constData(), json.size() );
+  qToLittleEndian< quint32 >( ResultJournal::Checksum( json.constData(), json.size() ), row + STORE_ROW_SIZE + 4 + json.size() );
+
+  if( mFile.write( record ) != record.size() || !mFile.flush() ) {
+    ERR( "Could not write to result store: %s", qt2cstr( mFile.errorString() ) );
+    return;
+  }
+
+  mClientIds.insert( clientId );
+  Index( result );
+  emit ResultAdded();
+}
+
+int ResultStore::Size() const {
+  return mResults.size();
+}
+
+const QVector< ResultStore::StoredResult >& ResultStore::Results() const {
+  return mResults;
+}
+
+QJsonObject ResultStore::Details( int index ) {
+  if( index < 0 || index >= mResults.size() )
+    return QJsonObject();
+
+  const StoredResult& result = mResults[ index ];
+  qint64 pos = mFile.pos();
+  mFile.seek( result.offset );
+  QByteArray data = mFile.read( result.size + 4 );
+  mFile.seek( pos );
+
+  if( data.size() != int( result.size + 4 ) ||
+      qFromLittleEndian< quint32 >( reinterpret_cast< const uchar* >( data.constData() + result.size ) ) != ResultJournal::Checksum( data.constData(), result.size ) )
+  {
+    ERR( "Result %d in the result store is damaged", index );
+    return QJsonObject();
+  }
+
+  return QJsonDocument::fromJson( data.left( result.size ) ).object();
+}
+
+bool ResultStore::Matches( const StoredResult& result, const ResultFilter& filter ) {
+  if( filter.mode != MODE_UNKNOWN && result.mode != filter.mode )
+    return false;
+  if( filter.hero != CLASS_UNKNOWN && result.hero != filter.hero )
+    return false;
+  if( filter.opponent != CLASS_UNKNOWN && result.opponent != filter.opponent )
+    return false;
+  if( filter.order != ORDER_UNKNOWN && result.order != filter.order )
+    return false;
+
+  if( filter.minRank || filter.maxRank ) {
+    if( result.rank == RANK_UNKNOWN )
+      return false;
+    if( filter.minRank && result.rank < filter.minRank )
+      return false;
+    if( filter.maxRank && result.rank > filter.maxRank )
+      return false;
+  }
+
+  if( filter.from.isValid() && result.added < filter.from.toMSecsSinceEpoch() )
+    return false;
+  if( filter.to.isValid() && result.added > filter.to.toMSecsSinceEpoch() )
+    return false;
+
+  return true;
+}
+
+// Walks the smallest index which covers the filter
+template< typename F >
+void ResultStore::ForEach( const ResultFilter& filter, F func ) const {
+  bool indexed = false;
+  const int *begin = NULL;
+  const int *end = NULL;
+  int best = mResults.size();
+
+  auto consider = [&]( const int *b, const int *e ) {
+    if( e - b < best ) {
+      indexed = true;
+      begin = b;
+      end = e;
+      best = e - b;
+    }
+  };
+
+  if( filter.hero < NUM_CLASSES )
+    consider( mByHero[ filter.hero ].constBegin(), mByHero[ filter.hero ].constEnd() );
+  if( filter.opponent < NUM_CLASSES )
+    consider( mByOpponent[ filter.opponent ].constBegin(), mByOpponent[ filter.opponent ].constEnd() );
+  if( filter.mode < MODE_UNKNOWN )
+    consider( mByMode[ filter.mode ].constBegin(), mByMode[ filter.mode ].constEnd() );
+  if( filter.minRank > 0 && filter.minRank == filter.maxRank && filter.minRank < 26 )
+    consider( mByRank[ filter.minRank ].constBegin(), mByRank[ filter.minRank ].constEnd() );
+
+  if( filter.from.isValid() || filter.to.isValid() ) {
+    const int *b = mByDate.constBegin();
+    const int *e = mByDate.constEnd();
+    if( filter.from.isValid() ) {
+      qint64 from = filter.from.toMSecsSinceEpoch();
+      b = std::lower_bound( b, e, from, [this]( int i, qint64 added ) { return mResults[ i ].added < added; } );
+    }
+    if( filter.to.isValid() ) {
+      qint64 to = filter.to.toMSecsSinceEpoch();
+      e = std::upper_bound( b, e, to, [this]( qint64 added, int i ) { return added < mResults[ i ].added; } );
+    }
+    consider( b, e );
+  }
+
+  if( indexed ) {
+    for( const int *it = begin; it != end; ++it ) {
+      const StoredResult& result = mResults[ *it ];
+      if( Matches( result, filter ) )
+        func( result );
+    }
+  } else {
+    for( const StoredResult& result : mResults ) {
+      if( Matches( result, filter ) )
+        func( result );
+    }
+  }
+}
+
+int ResultStore::Count( const ResultFilter& filter ) const {
+  int count = 0;
+  ForEach( filter, [&]( const StoredResult& ) { count++; } );
+  return count;
+}
+
+WinLoss ResultStore::Total( const ResultFilter& filter ) const {
+  WinLoss total = { 0, 0 };
+  ForEach( filter, [&]( const StoredResult& result ) {
+    total.games++;
+    total.wins += result.outcome == OUTCOME_VICTORY;
+  });
+  return total;
+}
+
+QVector< WinLoss > ResultStore::ByMatchup( const ResultFilter& filter ) const {
+  WinLoss none = { 0, 0 };
+  QVector< WinLoss > matchups( NUM_CLASSES * NUM_CLASSES, none );
+  ForEach( filter, [&]( const StoredResult& result ) {
+    if( result.hero >= NUM_CLASSES || result.opponent >= NUM_CLASSES )
+      return;
+
+    WinLoss& matchup = matchups[ result.hero * NUM_CLASSES + result.opponent ];
+    matchup.games++;
+    matchup.wins += result.outcome == OUTCOME_VICTORY;
+  });
+  return matchups;
+}
+
+QVector< WinLoss > ResultStore::ByOrder( const ResultFilter& filter ) const {
+  WinLoss none = { 0, 0 };
+  QVector< WinLoss > orders( ORDER_UNKNOWN, none );
+  ForEach( filter, [&]( const StoredResult& result ) {
+    if( result.order >= ORDER_UNKNOWN )
+      return;
+
+    orders[ result.order ].games++;
+    orders[ result.order ].wins += result.outcome == OUTCOME_VICTORY;
+  });
+  return orders;
+}
+
+QMap< int, WinLoss > ResultStore::ByRankBand( const ResultFilter& filter, int bandSize ) const {
+  bandSize = qMax( bandSize, 1 );
+
+  QMap< int, WinLoss > bands;
+  ForEach( filter, [&]( const StoredResult& result ) {
+    if( result.mode != MODE_RANKED )
+      return;
+
+    int band;
+    if( result.legend != LEGEND_UNKNOWN ) {
+      band = 0;
+    } else if( result.rank != RANK_UNKNOWN ) {
+      band = ( result.rank - 1 ) / bandSize * bandSize + 1;
+    } else {
+      return;
+    }
+
+    WinLoss& winLoss = bands[ band ];
+    winLoss.games++;
+    winLoss.wins += result.outcome == OUTCOME_VICTORY;
+  });
+  return bands;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Result.h"
+
+#include <QObject>
+#include <QFile>
+#include <QMap>
+#include <QSet>
+#include <QVector>
+#include <QJsonObject>
+
+typedef struct {
+  int games;
+  int wins;
+} WinLoss;
+
+inline float Winrate( const WinLoss& winLoss ) {
+  return winLoss.games ? float( winLoss.wins ) / winLoss.games : 0.0f;
+}
+
+// Which results a query looks at, everything by default
+class ResultFilter {
+public:
+  GameMode mode;       // MODE_UNKNOWN: any
+  HeroClass hero;      // CLASS_UNKNOWN: any
+  HeroClass opponent;  // CLASS_UNKNOWN: any
+  GoingOrder order;    // ORDER_UNKNOWN: any
+
+  // Ranked games with a rank in [minRank, maxRank] (legend excluded), 0 for no bound
+  int minRank;
+  int maxRank;
+
+  QDateTime from;      // invalid: no bound
+  QDateTime to;
+
+  ResultFilter()
+    : mode( MODE_UNKNOWN ), hero( CLASS_UNKNOWN ), opponent( CLASS_UNKNOWN ), order( ORDER_UNKNOWN ),
+      minRank( 0 ), maxRank( 0 )
+  {
+  }
+};
+
+// Every result played on this machine, kept for local statistics
+//
+// Results are appended to one file. Each record starts with the fields
+// statistics need (fixed size, own CRC32), followed by the full result
+// JSON incl. card history. Opening the store only reads the fixed part,
+// the JSON is read on demand. A torn record at the end is dropped.
+//
+// In memory the store keeps those fields for every result plus indexes
+// by hero, opponent, mode, rank and date. A query starts from the most
+// selective index and checks the remaining conditions row by row.
+//
+// READ_ONLY is for looking at the store of a running app: it never
+// creates, truncates or appends, a torn tail is only skipped.
+class ResultStore : public QObject
+{
+  Q_OBJECT
+
+public:
+  typedef enum {
+    READ_WRITE,
+    READ_ONLY
+  } OpenMode;
+
+  typedef struct {
+    qint64  added;    // ms since epoch (UTC)
+    qint64  offset;   // of the JSON in the file
+    quint32 size;     // of the JSON
+    quint32 legend;
+    quint32 duration;
+    quint8  mode;
+    quint8  outcome;
+    quint8  order;
+    quint8  hero;
+    quint8  opponent;
+    quint8  rank;
+  } StoredResult;
+
+private:
+  QString  mPath;
+  QFile    mFile;
+  OpenMode mMode;
+
+  QVector< StoredResult > mResults; // in file order
+  QSet< QByteArray > mClientIds;
+
+  // Positions in mResults
+  QVector< int > mByDate;
+  QVector< int > mByHero[ NUM_CLASSES ];
+  QVector< int > mByOpponent[ NUM_CLASSES ];
+  QVector< int > mByMode[ MODE_UNKNOWN ];
+  QVector< int > mByRank[ 26 ];
+
+  bool Load();
+  void Index( const StoredResult& result );
+
+  template< typename F >
+  void ForEach( const ResultFilter& filter, F func ) const;
+  static bool Matches( const StoredResult& result, const ResultFilter& filter );
+
+signals:
+  void ResultAdded();
+
+public slots:
+  void Add( const Result& result );
+
+public:
+  ResultStore( const QString& path = QString(), OpenMode mode = READ_WRITE, QObject *parent = 0 );
+  ~ResultStore();
+
+  const QString& Path() const;
+  bool IsOpen() const;
+
+  int Size() const;
+  const QVector< StoredResult >& Results() const;
+
+  // Full result as it was uploaded (incl. card history), empty if unreadable
+  QJsonObject Details( int index );
+
+  int Count( const ResultFilter& filter ) const;
+  WinLoss Total( const ResultFilter& filter ) const;
+
+  // NUM_CLASSES x NUM_CLASSES, index with hero * NUM_CLASSES + opponent
+  QVector< WinLoss > ByMatchup( const ResultFilter& filter ) const;
+
+  // Index with ORDER_FIRST, ORDER_SECOND
+  QVector< WinLoss > ByOrder( const ResultFilter& filter ) const;
+
+  // Ranked games by the best rank of their band (1, 6, 11, ... for bands of 5),
+  // legend games under 0, games without a known rank are left out
+  QMap< int, WinLoss > ByRankBand( const ResultFilter& filter, int bandSize = 5 ) const;
+};
@@ -1,16 +1,69 @@
 #include "ResultTracker.h"
 #include "Hearthstone.h"
+#include "Settings.h"
+
+#include <QElapsedTimer>
+#include <QtConcurrent>
 
 #include <map>
 
+// Free the rank classifier when no game was played for a while
+#define RANK_CLASSIFIER_RELEASE_TIMEOUT (15 * 60 * 1000)
+
 ResultTracker::ResultTracker( QObject *parent )
-  : QObject( parent ), mSpectating( false ), mCurrentGameMode( MODE_UNKNOWN )
+  : QObject( parent ), mSpectating( false ), mCurrentGameMode( MODE_UNKNOWN ), mRankClassifier( NULL ), mRankVotedEarly( false )
 {
   connect( Hearthstone::Instance(), &Hearthstone::GameStarted, this, &ResultTracker::HandleHearthstoneStart );
+  connect( &mResultsQueue, &ResultQueue::ResultQueued, this, &ResultTracker::ResultRecorded );
+
+  mRankClassifierReleaseTimer = new QTimer( this );
+  mRankClassifierReleaseTimer->setSingleShot( true );
+  connect( mRankClassifierReleaseTimer, &QTimer::timeout, this, &ResultTracker::ReleaseRankClassifier );
+
+  // One worker is plenty, classification takes a few ms per turn
+  mRankClassifierPool.setMaxThreadCount( 1 );
+
   ResetResult();
 }
 
 ResultTracker::~ResultTracker() {
+  mRankClassifierPool.waitForDone();
+  mPendingRankVotes.clear();
+  ReleaseRankClassifier();
+}
+
+// The classifier is only needed once a game is under way
+// so load it on demand and keep it around while in use
+RankClassifier* ResultTracker::AcquireRankClassifier() {
+  if( !mRankClassifier ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    mRankClassifier = new RankClassifier();
+
+    int loadTime = timer.elapsed();
+    int modelSize = mRankClassifier->ModelSize() / 1024;
+    LOG( "Rank classifier loaded in %d ms (%d KB)", loadTime, modelSize );
+    METADATA( "RANK_CLASSIFIER_LOAD_TIME", loadTime );
+    METADATA( "RANK_CLASSIFIER_MODEL_SIZE", modelSize );
+  }
+
+  mRankClassifierReleaseTimer->start( RANK_CLASSIFIER_RELEASE_TIMEOUT );
+  return mRankClassifier;
+}
+
+void ResultTracker::ReleaseRankClassifier() {
+  // Workers might still use it
+  if( !mPendingRankVotes.isEmpty() ) {
+    mRankClassifierReleaseTimer->start( RANK_CLASSIFIER_RELEASE_TIMEOUT );
+    return;
+  }
+
+  if( mRankClassifier ) {
+    DBG( "Release rank classifier" );
+    delete mRankClassifier;
+    mRankClassifier = NULL;
+  }
 }
 
 void ResultTracker::HandleHearthstoneStart() {
@@ -20,13 +73,21 @@ void ResultTracker::HandleHearthstoneStart() {
   DBG( "Region detected: %s", qt2cstr( mRegion ) );
 
   ResetResult();
+  mMatchStart = QDateTime();
   // Make sure we reset spectating mode when game is started
   mSpectating = false;
 }
 
 void ResultTracker::ResetResult() {
   mResult.Reset();
+
+  // Votes of a discarded result are not interesting anymore
+  for( QFuture< QList< RankVote > >& future : mPendingRankVotes ) {
+    future.waitForFinished();
+  }
+  mPendingRankVotes.clear();
   mRanks.clear();
+  mRankVotedEarly = false;
 }
 
 void ResultTracker::HandleOrder( GoingOrder order ) {
@@ -52,6 +113,12 @@ void ResultTracker::HandleOpponentClass( HeroClass opponentClass ) {
 void ResultTracker::HandleMatchStart() {
   DBG( "HandleMatchStart" );
   mDurationTimer.start();
+
+  // The result is stamped with the start, so a match end reported
+  // twice gives the same result (and client id) twice
+  QDateTime now = QDateTime::currentDateTime();
+  mMatchStart = now.addMSecs( -now.time().msec() );
+  mResultsQueue.Prewarm();
 }
 
 void ResultTracker::HandleSpectating( bool nowSpectating ) {
@@ -77,7 +144,7 @@ void ResultTracker::HandleMatchEnd() {
 
   DBG( "HandleMatchEnd" );
   mResult.duration = mDurationTimer.elapsed() / 1000;
-  mResult.added = QDateTime::currentDateTime();
+  mResult.added = mMatchStart.isValid() ? mMatchStart : QDateTime::currentDateTime();
   mResult.mode = mCurrentGameMode;
   mResult.region = mRegion;
   UploadResult();
@@ -94,19 +161,83 @@ void ResultTracker::HandleLegend( int legend ) {
 }
 
 void ResultTracker::HandleTurn( int turn ) {
-  UNUSED_ARG( turn );
-
+  // Not gated on MODE_RANKED: the log tracker reports ranked games as
+  // casual until the rank window shows up after the match. Ranks of
+  // other modes are dropped with their metadata by ResultQueue::Add
   if( turn > 1 ) { // turn 1 (first player) happens before game is in-effect [mulligan]
-    QImage label;
-    float score;
+    const RankClassifier *classifier = AcquireRankClassifier();
+
+    // Opt-in: vote with several jittered crops of one capture right away
+    // instead of one crop per turn
+    if( Settings::Instance()->RankClassifierBatched() ) {
+      if( mRankVotedEarly )
+        return;
+
+      // Window or badge not there yet: try again next turn
+      if( !RankClassifier::CaptureJitteredLabels( &mRankJitteredLabels ) )
+        return;
+
+      // Shares the buffer; the worker is done with it long before the next capture
+      QImage raw = mRankJitteredLabels;
+      mPendingRankVotes << QtConcurrent::run( &mRankClassifierPool, [classifier, raw, turn]() {
+        QList< RankVote > votes;
+        for( const QPair< int, float >& classification : classifier->ClassifyJittered( raw ) ) {
+          RankVote vote;
+          vote.turn = turn;
+          vote.rank = classification.first;
+          vote.score = classification.second;
+          vote.cached = false;
+          votes << vote;
+        }
+        return votes;
+      });
+      mRankVotedEarly = true;
+      return;
+    }
+
+    // Grab the label here, classification happens on the worker
+    if( !RankClassifier::CaptureLabel( &mRankLabel ) )
+      return;
+
+    QImage raw = mRankLabel;
+
+    mPendingRankVotes << QtConcurrent::run( &mRankClassifierPool, [classifier, raw, turn]() {
+      RankVote vote;
+      vote.turn = turn;
+      vote.rank = classifier->Classify( raw, &vote.score, NULL, &vote.cached );
+      return QList< RankVote >() << vote;
+    });
+  }
+}
+
+void ResultTracker::CollectRankVotes() {
+  int cacheHits = 0;
+
+  for( QFuture< QList< RankVote > >& future : mPendingRankVotes ) {
+    QList< RankVote > votes = future.result(); // blocks until classified
+
+    for( int i = 0; i < votes.size(); i++ ) {
+      const RankVote& vote = votes[ i ];
 
-    int rank = mRankClassifier.DetectCurrentRank( &score, &label );
-    mRanks.push_back( rank );
-    DBG( "Turn %d. Set Rank %d", turn, rank );
+      // Cached classifications still count as a vote
+      mRanks.push_back( vote.rank );
+      DBG( "Turn %d. Set Rank %d%s", vote.turn, vote.rank, vote.cached ? " (cached)" : "" );
+
+      if( vote.cached ) {
+        cacheHits++;
+      }
+
+      // Jittered crops of the same turn are told apart by index
+      QString key = votes.size() > 1 ? QString( "%1_%2" ).arg( vote.turn ).arg( i ) : QString::number( vote.turn );
+      METADATA( QString( "RANK_CLASSIFIER_%1_RANK" ).arg( key ), vote.rank );
+      METADATA( QString( "RANK_CLASSIFIER_%1_SCORE" ).arg( key ), vote.score );
+    }
+  }
 
-    METADATA( QString( "RANK_CLASSIFIER_%1_RANK" ).arg( turn ), rank );
-    METADATA( QString( "RANK_CLASSIFIER_%1_SCORE" ).arg( turn ), score );
+  if( !mPendingRankVotes.isEmpty() ) {
+    METADATA( "RANK_CLASSIFIER_CACHE_HITS", cacheHits );
   }
+  mPendingRankVotes.clear();
 }
 
 // Screen capture can be tricky
@@ -136,6 +267,7 @@ int ResultTracker::DetermineRank() {
 void ResultTracker::UploadResult() {
   DBG( "UploadResult" );
 
+  CollectRankVotes();
   mResult.rank = DetermineRank();
   DBG( "Determined Rank: %d", mResult.rank );
 
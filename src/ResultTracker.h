@@ -6,22 +6,43 @@
 
 #include <QTimer>
 #include <QTime>
+#include <QDateTime>
+#include <QFuture>
+#include <QThreadPool>
 
 #include <vector>
 
+typedef struct {
+  int turn;
+  int rank;
+  float score;
+  bool cached;
+} RankVote;
+
 class ResultTracker : public QObject
 {
   Q_OBJECT
 
 private:
   QTime                 mDurationTimer;
+  QDateTime             mMatchStart; // whole seconds, like Result::AsJson
   bool                  mSpectating;
 
   Result                mResult;
   GameMode              mCurrentGameMode;
 
   std::vector<int>      mRanks;
-  RankClassifier        mRankClassifier;
+  RankClassifier       *mRankClassifier;
+  QTimer               *mRankClassifierReleaseTimer;
+
+  // Rank classification runs on a worker, votes are collected before the upload
+  QThreadPool           mRankClassifierPool;
+  QList< QFuture< QList< RankVote > > > mPendingRankVotes;
+  bool                  mRankVotedEarly; // jittered batch already taken this match
+
+  // Capture targets, reused for every turn of the session
+  QImage                mRankLabel;
+  QImage                mRankJitteredLabels;
 
   ResultQueue           mResultsQueue;
 
@@ -31,6 +52,15 @@ private:
   void UploadResult();
 
   int DetermineRank();
+  void CollectRankVotes();
+
+  RankClassifier* AcquireRankClassifier();
+
+private slots:
+  void ReleaseRankClassifier();
+
+signals:
+  void ResultRecorded( const Result& result );
 
 public slots:
   void HandleHearthstoneStart();
@@ -16,6 +16,7 @@ DEFINE_SINGLETON_SCOPE( Settings );
 #define KEY_DEBUG_ENABLED "debug"
 #define KEY_HEARTHSTONE_DIRECTORY_PATH "hearthstoneDirectoryPath"
 #define KEY_OVERLAY_ENABLED "overlayEnabled"
+#define KEY_RANK_CLASSIFIER_BATCHED "rankClassifierBatched"
 
 #ifdef Q_OS_LINUX
 #define KEY_WINEPREFIX_PATH "winePrefixPath"
@@ -112,6 +113,15 @@ void Settings::SetOverlayEnabled( bool enabled ) {
   emit OverlayEnabledChanged( enabled );
 }
 
+bool Settings::RankClassifierBatched() const {
+  return QSettings().value( KEY_RANK_CLASSIFIER_BATCHED, false ).toBool();
+}
+
+void Settings::SetRankClassifierBatched( bool enabled ) {
+  QSettings().setValue( KEY_RANK_CLASSIFIER_BATCHED, enabled );
+  emit RankClassifierBatchedChanged( enabled );
+}
+
 QString Settings::HearthstoneDirectoryPath() const {
   QString path = QSettings().value( KEY_HEARTHSTONE_DIRECTORY_PATH ).toString();
   if( path.isEmpty() ) {
@@ -17,6 +17,7 @@ signals:
   void HearthstoneDirectoryPathChanged( const QString& path );
   void OverlayEnabledChanged( bool enabled );
   void WinePrefixPathChanged( const QString& path );
+  void RankClassifierBatchedChanged( bool enabled );
 
 public:
   QString AccountUsername() const;
@@ -40,6 +41,9 @@ public:
   bool OverlayEnabled() const;
   void SetOverlayEnabled( bool enabled );
 
+  bool RankClassifierBatched() const;
+  void SetRankClassifierBatched( bool enabled );
+
   QString HearthstoneDirectoryPath() const;
   void SetHearthstoneDirectoryPath( const QString& path );
 #ifdef Q_OS_LINUX
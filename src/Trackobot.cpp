@@ -20,6 +20,7 @@
 #endif
 
 #include "Hearthstone.h"
+#include "ReplayWindowCapture.h"
 #include "WebProfile.h"
 
 #include <cassert>
@@ -37,8 +38,10 @@ Trackobot::Trackobot( int& argc, char **argv )
 #ifdef Q_OS_LINUX
   WinePrefix->SetPath( Settings::Instance()->WinePrefixPath() );
 #endif
+  SetupReplayCapture();
   mWebProfile = new WebProfile( this );
   mResultTracker = new ResultTracker( this );
+  mResultStore = new ResultStore( QString(), ResultStore::READ_WRITE, this );
   mLogTracker = new HearthstoneLogTracker( this );
 }
 
@@ -133,6 +136,25 @@ void Trackobot::SetupApplication() {
   setWindowIcon( icon );
 }
 
+// --replay-capture <dir> [--replay-interval <ms>] [--replay-loop]
+// Use recorded screenshots instead of the game window (benchmarks, testing)
+void Trackobot::SetupReplayCapture() {
+  QStringList args = arguments();
+  int dirIdx = args.indexOf( "--replay-capture" );
+  if( dirIdx < 0 || dirIdx + 1 >= args.size() )
+    return;
+
+  ReplayWindowCapture *capture = new ReplayWindowCapture( args[ dirIdx + 1 ] );
+
+  int intervalIdx = args.indexOf( "--replay-interval" );
+  if( intervalIdx > 0 && intervalIdx + 1 < args.size() ) {
+    capture->SetFrameInterval( args[ intervalIdx + 1 ].toInt() );
+  }
+  capture->SetLoop( args.contains( "--replay-loop" ) );
+
+  Hearthstone::Instance()->SetWindowCapture( capture );
+}
+
 void Trackobot::SetupLogging() {
   // Logging
   QString dataLocation = QStandardPaths::writableLocation( QStandardPaths::DataLocation );
@@ -158,7 +180,7 @@ void Trackobot::SetupUpdater() {
 
 void Trackobot::CreateUI() {
   mOverlay = new Overlay();
-  mWindow = new Window();
+  mWindow = new Window( mResultStore );
 }
 
 void Trackobot::WireStuff() {
@@ -178,6 +200,9 @@ void Trackobot::WireStuff() {
   connect( mLogTracker, &HearthstoneLogTracker::HandleMatchStart, mResultTracker, &ResultTracker::HandleMatchStart );
   connect( mLogTracker, &HearthstoneLogTracker::HandleMatchEnd, mResultTracker, &ResultTracker::HandleMatchEnd );
 
+  // Local statistics
+  connect( mResultTracker, &ResultTracker::ResultRecorded, mResultStore, &ResultStore::Add );
+
   // Overlay
   connect( mLogTracker, &HearthstoneLogTracker::HandleCardsDrawnUpdate, mOverlay, &Overlay::HandleCardsDrawnUpdate );
 
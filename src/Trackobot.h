@@ -4,6 +4,7 @@
 #include <QLocalServer>
 
 #include "ResultTracker.h"
+#include "ResultStore.h"
 #include "WebProfile.h"
 #include "HearthstoneLogTracker.h"
 
@@ -20,12 +21,14 @@ private:
   QLocalServer *mSingleInstanceServer;
 
   ResultTracker *mResultTracker;
+  ResultStore *mResultStore;
   WebProfile *mWebProfile;
   HearthstoneLogTracker *mLogTracker;
 
   bool IsAlreadyRunning();
 
   void SetupApplication();
+  void SetupReplayCapture();
   void SetupLogging();
   void SetupUpdater();
 
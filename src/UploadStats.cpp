@@ -0,0 +1,244 @@
+#include "UploadStats.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+
+DEFINE_SINGLETON_SCOPE( UploadStats );
+
+#define UPLOAD_STATS_SNAPSHOT_VERSION 1
+
+// Requests take 100s of ms, results can wait in the queue for hours
+static const QVector< qint64 > REQUEST_LATENCY_BOUNDS = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000 };
+static const QVector< qint64 > ACK_LATENCY_BOUNDS = { 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000,
+  5 * 60000, 15 * 60000, 60 * 60000, 6 * 60 * 60000 };
+static const QVector< qint64 > BACKLOG_BOUNDS = { 0, 1, 2, 5, 10, 25, 50, 100, 250, 1000 };
+
+Histogram::Histogram( const QVector< qint64 >& bounds )
+  : mBounds( bounds )
+{
+  Clear();
+}
+
+void Histogram::Add( qint64 value ) {
+  int bucket = std::lower_bound( mBounds.constBegin(), mBounds.constEnd(), value ) - mBounds.constBegin();
+  mCounts[ bucket ]++;
+  mCount++;
+  mSum += value;
+  mMax = mCount == 1 ? value : qMax( mMax, value );
+}
+
+void Histogram::Clear() {
+  mCounts.fill( 0, mBounds.size() + 1 );
+  mCount = 0;
+  mSum = 0;
+  mMax = 0;
+}
+
+int Histogram::Count() const {
+  return mCount;
+}
+
+qint64 Histogram::Max() const {
+  return mMax;
+}
+
+qint64 Histogram::Mean() const {
+  return mCount ? mSum / mCount : 0;
+}
+
+qint64 Histogram::Percentile( int percent ) const {
+  if( !mCount )
+    return 0;
+
+  // Rank of the value, rounded up
+  int rank = qMax( 1, int( ( qint64( mCount ) * percent + 99 ) / 100 ) );
+  int seen = 0;
+  for( int i = 0; i < mBounds.size(); i++ ) {
+    seen += mCounts[ i ];
+    if( seen >= rank )
+      return qMin( mBounds[ i ], mMax );
+  }
+  return mMax;
+}
+
+QJsonObject Histogram::AsJson() const {
+  QJsonArray buckets;
+  for( int i = 0; i < mCounts.size(); i++ ) {
+    QJsonObject bucket;
+    if( i < mBounds.size() ) {
+      bucket[ "le" ] = mBounds[ i ];
+    }
+    bucket[ "count" ] = mCounts[ i ];
+    buckets.append( bucket );
+  }
+
+  QJsonObject json;
+  json[ "count" ] = mCount;
+  json[ "sum" ] = mSum;
+  json[ "max" ] = mMax;
+  json[ "p50" ] = Percentile( 50 );
+  json[ "p90" ] = Percentile( 90 );
+  json[ "p99" ] = Percentile( 99 );
+  json[ "buckets" ] = buckets; // last one without le: everything larger
+  return json;
+}
+
+UploadStats::UploadStats()
+  : mRequestLatency( REQUEST_LATENCY_BOUNDS ), mAckLatency( ACK_LATENCY_BOUNDS ), mBacklogDepth( BACKLOG_BOUNDS )
+{
+  Reset();
+}
+
+UploadStats::~UploadStats() {
+}
+
+void UploadStats::Reset() {
+  mSince = QDateTime::currentDateTimeUtc();
+
+  mRequests = 0;
+  mBytesSent = 0;
+  mJsonBytes = 0;
+  mStatusCodes.clear();
+  mRequestLatency.Clear();
+
+  mQueued = 0;
+  mUploaded = 0;
+  mRejected = 0;
+  mDuplicates = 0;
+  mRetries = 0;
+  mBacklog = 0;
+  mMaxBacklog = 0;
+  mAckLatency.Clear();
+  mBacklogDepth.Clear();
+
+  emit Changed();
+}
+
+void UploadStats::SetBacklog( int backlog ) {
+  mBacklog = backlog;
+  mMaxBacklog = qMax( mMaxBacklog, backlog );
+}
+
+void UploadStats::RecordRequest( int httpStatusCode, qint64 bytesSent, qint64 jsonBytes, qint64 msecs ) {
+  mRequests++;
+  mBytesSent += bytesSent;
+  mJsonBytes += jsonBytes;
+  mStatusCodes[ httpStatusCode ]++;
+  mRequestLatency.Add( msecs );
+  emit Changed();
+}
+
+void UploadStats::RecordBacklog( int backlog ) {
+  SetBacklog( backlog );
+  emit Changed();
+}
+
+void UploadStats::RecordQueued( int backlog ) {
+  mQueued++;
+  SetBacklog( backlog );
+  mBacklogDepth.Add( backlog );
+  emit Changed();
+}
+
+void UploadStats::RecordDuplicate() {
+  mDuplicates++;
+  emit Changed();
+}
+
+void UploadStats::RecordUploaded( qint64 msecs, int backlog ) {
+  mUploaded++;
+  if( msecs >= 0 ) {
+    mAckLatency.Add( msecs );
+  }
+  SetBacklog( backlog );
+  emit Changed();
+}
+
+void UploadStats::RecordRejected( int backlog ) {
+  mRejected++;
+  SetBacklog( backlog );
+  emit Changed();
+}
+
+void UploadStats::RecordRetry() {
+  mRetries++;
+  emit Changed();
+}
+
+int UploadStats::Requests() const {
+  return mRequests;
+}
+
+qint64 UploadStats::BytesSent() const {
+  return mBytesSent;
+}
+
+const QMap< int, int >& UploadStats::StatusCodes() const {
+  return mStatusCodes;
+}
+
+const Histogram& UploadStats::RequestLatency() const {
+  return mRequestLatency;
+}
+
+int UploadStats::Queued() const {
+  return mQueued;
+}
+
+int UploadStats::Uploaded() const {
+  return mUploaded;
+}
+
+int UploadStats::Rejected() const {
+  return mRejected;
+}
+
+int UploadStats::Duplicates() const {
+  return mDuplicates;
+}
+
+int UploadStats::Retries() const {
+  return mRetries;
+}
+
+int UploadStats::Backlog() const {
+  return mBacklog;
+}
+
+const Histogram& UploadStats::AckLatency() const {
+  return mAckLatency;
+}
+
+QJsonObject UploadStats::Snapshot() const {
+  QJsonObject status;
+  for( auto it = mStatusCodes.constBegin(); it != mStatusCodes.constEnd(); ++it ) {
+    status[ QString::number( it.key() ) ] = it.value();
+  }
+
+  QJsonObject requests;
+  requests[ "count" ] = mRequests;
+  requests[ "bytes_sent" ] = mBytesSent;
+  requests[ "json_bytes" ] = mJsonBytes;
+  requests[ "status" ] = status; // "0": no HTTP response
+  requests[ "latency_ms" ] = mRequestLatency.AsJson();
+
+  QJsonObject results;
+  results[ "queued" ] = mQueued;
+  results[ "uploaded" ] = mUploaded;
+  results[ "rejected" ] = mRejected;
+  results[ "duplicates" ] = mDuplicates;
+  results[ "retries" ] = mRetries;
+  results[ "backlog" ] = mBacklog;
+  results[ "max_backlog" ] = mMaxBacklog;
+  results[ "ack_latency_ms" ] = mAckLatency.AsJson();
+  results[ "backlog_depth" ] = mBacklogDepth.AsJson();
+
+  QJsonObject snapshot;
+  snapshot[ "version" ] = UPLOAD_STATS_SNAPSHOT_VERSION;
+  snapshot[ "since" ] = mSince.toString( Qt::ISODate );
+  snapshot[ "taken" ] = QDateTime::currentDateTimeUtc().toString( Qt::ISODate );
+  snapshot[ "requests" ] = requests;
+  snapshot[ "results" ] = results;
+  return snapshot;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QObject>
+#include <QDateTime>
+#include <QMap>
+#include <QVector>
+#include <QJsonObject>
+
+// Counts values into fixed buckets, each value goes into the first
+// bucket with bound >= value, larger ones into an overflow bucket
+class Histogram {
+private:
+  QVector< qint64 > mBounds;
+  QVector< int >    mCounts; // one more than bounds
+  int    mCount;
+  qint64 mSum;
+  qint64 mMax;
+
+public:
+  Histogram( const QVector< qint64 >& bounds = QVector< qint64 >() );
+
+  void Add( qint64 value );
+  void Clear();
+
+  int Count() const;
+  qint64 Max() const;
+  qint64 Mean() const;
+
+  // Bound of the bucket the percentile falls into, the max value for the overflow bucket
+  qint64 Percentile( int percent ) const;
+
+  QJsonObject AsJson() const;
+};
+
+// How uploads went this session
+//
+// WebProfile records every request (HTTP status, bytes, time to the
+// reply), ResultQueue what happens to the results (enqueue to ack,
+// backlog, retries). Shown in the Stats tab and saved as JSON snapshot.
+class UploadStats : public QObject
+{
+  Q_OBJECT
+
+  DEFINE_SINGLETON( UploadStats );
+
+private:
+  QDateTime mSince;
+
+  int    mRequests;
+  qint64 mBytesSent;
+  qint64 mJsonBytes;
+  QMap< int, int > mStatusCodes; // 0: no HTTP response
+  Histogram mRequestLatency;
+
+  int mQueued;
+  int mUploaded;
+  int mRejected;
+  int mDuplicates;
+  int mRetries;
+  int mBacklog;
+  int mMaxBacklog;
+  Histogram mAckLatency;   // results queued this session only
+  Histogram mBacklogDepth; // when a result is queued
+
+  void SetBacklog( int backlog );
+
+signals:
+  void Changed();
+
+public:
+  // WebProfile
+  void RecordRequest( int httpStatusCode, qint64 bytesSent, qint64 jsonBytes, qint64 msecs );
+
+  // ResultQueue, backlog: results not uploaded yet
+  void RecordBacklog( int backlog );
+  void RecordQueued( int backlog );
+  void RecordDuplicate();
+  void RecordUploaded( qint64 msecs, int backlog ); // msecs < 0: queued in an earlier session
+  void RecordRejected( int backlog );
+  void RecordRetry();
+
+  int Requests() const;
+  qint64 BytesSent() const;
+  const QMap< int, int >& StatusCodes() const;
+  const Histogram& RequestLatency() const;
+
+  int Queued() const;
+  int Uploaded() const;
+  int Rejected() const;
+  int Duplicates() const;
+  int Retries() const;
+  int Backlog() const;
+  const Histogram& AckLatency() const;
+
+  // Everything above, machine readable
+  QJsonObject Snapshot() const;
+
+  void Reset();
+};
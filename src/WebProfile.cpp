@@ -5,6 +5,11 @@
 #include <QUrl>
 #include <QTimer>
 #include <QDesktopServices>
+#include <QDateTime>
+#include <QLocale>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <QSslConfiguration>
 
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -13,9 +18,17 @@
 #include "Hearthstone.h"
 
 #include "Settings.h"
+#include "UploadStats.h"
+#include "ResultJournal.h"
 
 #define DEFAULT_WEBSERVICE_URL "https://trackobot.com"
 
+// Qt drops idle connections after 2 minutes, touch the prewarmed one before that
+#define WEB_PROFILE_WARM_INTERVAL (90 * 1000)
+
+// Give up keeping it warm after half an hour without an upload
+#define WEB_PROFILE_WARM_MAX_TICKS 20
+
 
 /* According to a comment not happening with Qt 5.8+ */
 /* #if defined(Q_OS_MAC) && !defined(QT_NO_BEARERMANAGEMENT) */
@@ -23,9 +36,18 @@
 /* #endif */
 
 WebProfile::WebProfile( QObject *parent )
-  : QObject( parent )
+  : QObject( parent ), mGzipSupported( false ), mWarmTicks( 0 )
 {
   connect( &mNetworkManager, &QNetworkAccessManager::sslErrors, this, &WebProfile::SSLErrors );
+
+  mWarmTimer = new QTimer( this );
+  mWarmTimer->setInterval( WEB_PROFILE_WARM_INTERVAL );
+  connect( mWarmTimer, &QTimer::timeout, [this]() {
+    if( ++mWarmTicks >= WEB_PROFILE_WARM_MAX_TICKS ) {
+      mWarmTimer->stop();
+    }
+    ConnectToWebservice();
+  });
 }
 
 bool JsonFromReply( QNetworkReply *reply, QJsonObject *object ) {
@@ -42,6 +64,23 @@ bool JsonFromReply( QNetworkReply *reply, QJsonObject *object ) {
   return true;
 }
 
+// Retry-After is either a number of seconds or an HTTP date
+int RetryAfterFromReply( QNetworkReply *reply ) {
+  QByteArray value = reply->rawHeader( "Retry-After" ).trimmed();
+  if( value.isEmpty() )
+    return 0;
+
+  bool ok;
+  int seconds = value.toInt( &ok );
+  if( !ok ) {
+    QDateTime date = QLocale::c().toDateTime( QString::fromLatin1( value ), "ddd, dd MMM yyyy hh:mm:ss 'GMT'" );
+    date.setTimeSpec( Qt::UTC );
+    seconds = date.isValid() ? QDateTime::currentDateTimeUtc().secsTo( date ) : 0;
+  }
+
+  return qMax( seconds, 0 ) * 1000;
+}
+
 void WebProfile::EnsureAccountIsSetUp() {
   if( !Settings::Instance()->HasAccount() ) {
     LOG( "No account setup. Creating one for you." );
@@ -75,27 +114,139 @@ void WebProfile::UploadResult( const QJsonObject& result )
   }
   Metadata::Instance()->Clear();
 
-  QByteArray data = QJsonDocument( params ).toJson();
+  QByteArray data = QJsonDocument( params ).toJson( QJsonDocument::Compact );
 
-  QNetworkReply *reply = AuthPostJson( "/profile/results.json", data );
-  connect( reply, &QNetworkReply::finished, [&, reply, result]() {
+  // Bulk uploads carry the client_id of every result in the body instead
+  QByteArray idempotencyKey = result[ "client_id" ].toString().toLatin1();
+
+  // Exactly one signal per request, the queue keeps count of what is in flight
+  PostResultsJson( "/profile/results.json", data, idempotencyKey, [this, result]( QNetworkReply *reply ) {
     int replyCode = reply->error();
+    int statusCode = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
 
-    if( replyCode == QNetworkReply::NoError ) {
-      QJsonObject response;
-      if( JsonFromReply( reply, &response) ) {
-        emit UploadResultSucceeded( response );
-      }
+    QJsonObject response;
+    if( replyCode == QNetworkReply::NoError && JsonFromReply( reply, &response ) ) {
+      emit UploadResultSucceeded( result, response );
+    } else {
+      // An unreadable answer is retried too, the idempotency key makes that safe
+      emit UploadResultFailed( result, replyCode, statusCode, RetryAfterFromReply( reply ) );
+    }
+  });
+}
+
+// Several queued results in one request
+void WebProfile::UploadResults( const QJsonArray& results )
+{
+  QJsonObject params;
+  params[ "results" ] = results;
+
+  QByteArray data = QJsonDocument( params ).toJson( QJsonDocument::Compact );
+
+  PostResultsJson( "/profile/results/bulk.json", data, QByteArray(), [this, results]( QNetworkReply *reply ) {
+    int replyCode = reply->error();
+    int statusCode = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+
+    QJsonObject response;
+    if( replyCode == QNetworkReply::NoError && JsonFromReply( reply, &response ) &&
+        response[ "results" ].toArray().size() == results.size() )
+    {
+      emit UploadResultsSucceeded( results, response[ "results" ].toArray() );
     } else {
-      int statusCode = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
-      emit UploadResultFailed( result, replyCode, statusCode );
+      emit UploadResultsFailed( results, replyCode, statusCode, RetryAfterFromReply( reply ) );
+    }
+  });
+}
+
+// Result payloads are gzipped once the server said it can take them
+// A 415 means it changed its mind: send again as is and stop compressing
+void WebProfile::PostResultsJson( const QString& path, const QByteArray& json, const QByteArray& idempotencyKey, const std::function< void( QNetworkReply* ) >& handler ) {
+  bool gzipped = mGzipSupported;
+  QByteArray data = gzipped ? Gzip( json ) : json;
+  LOG( "Uploading %d bytes to %s (%d bytes of JSON)", data.size(), qt2cstr( path ), json.size() );
+
+  // The prewarmed connection is in use now
+  mWarmTimer->stop();
+
+  QElapsedTimer sent;
+  sent.start();
+
+  qint64 bytesSent = data.size();
+  QNetworkReply *reply = AuthPostJson( path, data, gzipped, idempotencyKey );
+  connect( reply, &QNetworkReply::finished, [this, reply, path, json, idempotencyKey, gzipped, handler, sent, bytesSent]() {
+    qint64 msecs = sent.elapsed();
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 9, 0 )
+    bool http2 = reply->attribute( QNetworkRequest::HTTP2WasUsedAttribute ).toBool();
+#else
+    bool http2 = false;
+#endif
+    LOG( "Upload to %s answered after %lld ms%s", qt2cstr( path ), msecs, http2 ? " (HTTP/2)" : "" );
+    emit UploadAcknowledged( path, msecs );
+
+    int statusCode = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    UploadStats::Instance()->RecordRequest( statusCode, bytesSent, json.size(), msecs );
+
+    if( gzipped && statusCode == 415 ) {
+      LOG( "Server does not accept compressed uploads anymore" );
+      mGzipSupported = false;
+      PostResultsJson( path, json, idempotencyKey, handler );
+    } else {
+      UpdateCapabilities( reply );
+      handler( reply );
     }
 
     reply->deleteLater();
   });
 }
 
-QNetworkReply* WebProfile::AuthPostJson( const QString& path, const QByteArray& data ) {
+void WebProfile::UpdateCapabilities( QNetworkReply *reply ) {
+  if( reply->error() != QNetworkReply::NoError || !reply->hasRawHeader( "Accept-Encoding" ) )
+    return;
+
+  bool gzipSupported = false;
+  for( const QByteArray& coding : reply->rawHeader( "Accept-Encoding" ).split( ',' ) ) {
+    QList< QByteArray > params = coding.split( ';' );
+    if( params.first().trimmed().toLower() != "gzip" )
+      continue;
+
+    // gzip;q=0 explicitly says no
+    float quality = 1.0f;
+    for( const QByteArray& param : params.mid( 1 ) ) {
+      if( param.trimmed().startsWith( "q=" ) ) {
+        quality = param.trimmed().mid( 2 ).toFloat();
+      }
+    }
+    gzipSupported = quality > 0.0f;
+  }
+
+  if( gzipSupported != mGzipSupported ) {
+    LOG( "Server %s compressed uploads", gzipSupported ? "accepts" : "does not accept" );
+    mGzipSupported = gzipSupported;
+  }
+}
+
+bool WebProfile::GzipSupported() const {
+  return mGzipSupported;
+}
+
+// qCompress yields a zlib stream behind a 4 byte size: keep the deflate data
+// and swap the zlib header/adler32 trailer for the gzip ones
+QByteArray WebProfile::Gzip( const QByteArray& data ) {
+  QByteArray zlib = qCompress( data );
+  QByteArray deflated = zlib.mid( 4 + 2, zlib.size() - 4 - 2 - 4 );
+
+  // Magic, deflate, no flags, no mtime, no extra flags, unknown OS
+  static const char header[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+
+  QByteArray gzip( sizeof( header ) + deflated.size() + 8, 0 );
+  uchar *ptr = reinterpret_cast< uchar* >( gzip.data() );
+  memcpy( ptr, header, sizeof( header ) );
+  memcpy( ptr + sizeof( header ), deflated.constData(), deflated.size() );
+  qToLittleEndian< quint32 >( ResultJournal::Checksum( data.constData(), data.size() ), ptr + sizeof( header ) + deflated.size() );
+  qToLittleEndian< quint32 >( data.size(), ptr + sizeof( header ) + deflated.size() + 4 );
+  return gzip;
+}
+
+QNetworkReply* WebProfile::AuthPostJson( const QString& path, const QByteArray& data, bool gzipped, const QByteArray& idempotencyKey ) {
   QString credentials = "Basic " +
     ( Settings::Instance()->AccountUsername() +
       ":" +
@@ -105,6 +256,12 @@ QNetworkReply* WebProfile::AuthPostJson( const QString& path, const QByteArray&
   QNetworkRequest request = CreateWebProfileRequest( path );
   request.setRawHeader( "Authorization", credentials.toLatin1() );
   request.setHeader( QNetworkRequest::ContentTypeHeader, "application/json" );
+  if( gzipped ) {
+    request.setRawHeader( "Content-Encoding", "gzip" );
+  }
+  if( !idempotencyKey.isEmpty() ) {
+    request.setRawHeader( "Idempotency-Key", idempotencyKey );
+  }
   return mNetworkManager.post( request, data );
 }
 
@@ -112,9 +269,37 @@ QNetworkRequest WebProfile::CreateWebProfileRequest( const QString& path ) {
   QUrl url( WebserviceURL( path ) );
   QNetworkRequest request( url );
   request.setRawHeader( "User-Agent", "Track-o-Bot/" VERSION PLATFORM );
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 8, 0 )
+  // One multiplexed connection for all uploads, if the server speaks HTTP/2
+  request.setAttribute( QNetworkRequest::HTTP2AllowedAttribute, true );
+#endif
   return request;
 }
 
+void WebProfile::Prewarm() {
+  DBG( "Prewarm connection to webservice" );
+  mWarmTicks = 0;
+  mWarmTimer->start();
+  ConnectToWebservice();
+}
+
+// The connection ends up in the manager's cache and is picked up by the next request
+void WebProfile::ConnectToWebservice() {
+  QUrl url( WebserviceURL( "" ) );
+  if( url.scheme() == "https" ) {
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 8, 0 )
+    // Offer h2 via ALPN so the connection matches what requests ask for
+    QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+    config.setAllowedNextProtocols( QList< QByteArray >() << QSslConfiguration::ALPNProtocolHTTP2 << QSslConfiguration::NextProtocolHttp1_1 );
+    mNetworkManager.connectToHostEncrypted( url.host(), url.port( 443 ), config );
+#else
+    mNetworkManager.connectToHostEncrypted( url.host(), url.port( 443 ) );
+#endif
+  } else {
+    mNetworkManager.connectToHost( url.host(), url.port( 80 ) );
+  }
+}
+
 void WebProfile::CreateAndStoreAccount() {
   QNetworkRequest request = CreateWebProfileRequest( "/users.json" );
   QNetworkReply *reply = mNetworkManager.post( request, "" );
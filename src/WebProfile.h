@@ -5,6 +5,10 @@
 #include <QSettings>
 #include <QSslError>
 #include <QJsonObject>
+#include <QJsonArray>
+#include <QTimer>
+
+#include <functional>
 
 class WebProfile : public QObject
 {
@@ -13,7 +17,17 @@ class WebProfile : public QObject
 private:
   QNetworkAccessManager mNetworkManager;
 
-  QNetworkReply* AuthPostJson( const QString& path, const QByteArray& data );
+  // Server announced it takes gzipped request bodies (Accept-Encoding in a response, RFC 7694)
+  bool mGzipSupported;
+
+  // Keeps the prewarmed connection from expiring until the next upload
+  QTimer *mWarmTimer;
+  int mWarmTicks;
+
+  QNetworkReply* AuthPostJson( const QString& path, const QByteArray& data, bool gzipped = false, const QByteArray& idempotencyKey = QByteArray() );
+  void PostResultsJson( const QString& path, const QByteArray& json, const QByteArray& idempotencyKey, const std::function< void( QNetworkReply* ) >& handler );
+  void UpdateCapabilities( QNetworkReply *reply );
+  void ConnectToWebservice();
 
 public slots:
   void OpenProfile();
@@ -27,17 +41,32 @@ private slots:
   QNetworkRequest CreateWebProfileRequest( const QString& path );
 
 signals:
-  void UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode );
-  void UploadResultSucceeded( const QJsonObject& response );
+  // retryAfter: ms the server asked us to wait (Retry-After), 0 if it did not say
+  void UploadResultFailed( const QJsonObject& result, int replyCode, int httpStatusCode, int retryAfter );
+  void UploadResultSucceeded( const QJsonObject& result, const QJsonObject& response );
+
+  // acks[ i ] belongs to results[ i ], either { "id": ... } or { "error": ... }
+  void UploadResultsFailed( const QJsonArray& results, int replyCode, int httpStatusCode, int retryAfter );
+  void UploadResultsSucceeded( const QJsonArray& results, const QJsonArray& acks );
+
+  // Time from sending an upload until the server's reply was in
+  void UploadAcknowledged( const QString& path, qint64 msecs );
 
 public:
   WebProfile( QObject *parent = 0 );
 
   bool IsAccountSetUp() const;
   void UploadResult( const QJsonObject& result );
+  void UploadResults( const QJsonArray& results );
   void CreateAndStoreAccount();
   void EnsureAccountIsSetUp();
 
+  // Open the connection (DNS, TCP, TLS) ahead of the next upload
+  void Prewarm();
+
   QString WebserviceURL( const QString& path );
+
+  bool GzipSupported() const;
+  static QByteArray Gzip( const QByteArray& data );
 };
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QPixmap>
+#include <QImage>
+
+#include <cstring>
 
 class WindowCapture
 {
@@ -17,6 +20,44 @@ public:
 
   virtual QPixmap Capture( int x, int y, int w, int h ) = 0;
 
+  // Backends which can read pixels directly override this
+  // to skip the pixmap round trip
+  virtual QImage CaptureImage( int x, int y, int w, int h ) {
+    return Capture( x, y, w, h ).toImage();
+  }
+
+  // Capture into a caller owned image, scaled to its size and converted
+  // to its format. Keep passing the same target to avoid allocations:
+  // backends override this to scale straight from their own buffers
+  virtual bool CaptureInto( int x, int y, int w, int h, QImage *target ) {
+    return CopyScaled( CaptureImage( x, y, w, h ), target );
+  }
+
+  static bool CopyScaled( const QImage& source, QImage *target ) {
+    if( source.isNull() || target->isNull() )
+      return false;
+
+    QImage image = source;
+    if( image.size() != target->size() ) {
+      image = image.scaled( target->size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+    }
+    if( image.format() != target->format() ) {
+      image = image.convertToFormat( target->format() );
+    }
+
+    int bytes = qMin( image.bytesPerLine(), target->bytesPerLine() );
+    for( int y = 0; y < target->height(); y++ ) {
+      memcpy( target->scanLine( y ), image.constScanLine( y ), bytes );
+    }
+    return true;
+  }
+
   virtual bool HasFocus() = 0;
+
+  // Backends which notify about window changes on their own
+  // do not need to be polled quickly while the game is running
+  virtual bool ReportsWindowChanges() {
+    return false;
+  }
 };
 
@@ -0,0 +1,160 @@
+#include "StatsTab.h"
+#include "ui_StatsWidget.h"
+
+#include "../ResultExporter.h"
+#include "../UploadStats.h"
+
+#include <QApplication>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QJsonDocument>
+#include <QMessageBox>
+
+#define STATS_RANK_BAND 5
+
+StatsTab::StatsTab( ResultStore *resultStore, QWidget *parent )
+  : QWidget( parent ), mUI( new Ui::StatsWidget ), mResultStore( resultStore )
+{
+  mUI->setupUi( this );
+
+  mUI->modeFilter->addItem( tr( "All modes" ), MODE_UNKNOWN );
+  mUI->modeFilter->addItem( tr( "Ranked" ), MODE_RANKED );
+  mUI->modeFilter->addItem( tr( "Casual" ), MODE_CASUAL );
+  mUI->modeFilter->addItem( tr( "Arena" ), MODE_ARENA );
+  mUI->modeFilter->addItem( tr( "Friendly" ), MODE_FRIENDLY );
+
+  QStringList classes;
+  for( int i = 0; i < NUM_CLASSES; i++ ) {
+    classes << QString( CLASS_NAMES[ i ] ).left( 3 );
+  }
+  mUI->matchupTable->setRowCount( NUM_CLASSES );
+  mUI->matchupTable->setColumnCount( NUM_CLASSES );
+  mUI->matchupTable->setVerticalHeaderLabels( classes );
+  mUI->matchupTable->setHorizontalHeaderLabels( classes );
+  mUI->matchupTable->horizontalHeader()->setSectionResizeMode( QHeaderView::Stretch );
+  mUI->matchupTable->verticalHeader()->setSectionResizeMode( QHeaderView::ResizeToContents );
+
+  connect( mUI->modeFilter, static_cast< void (QComboBox::*)(int) >( &QComboBox::currentIndexChanged ), this, &StatsTab::Update );
+  connect( mResultStore, &ResultStore::ResultAdded, this, &StatsTab::Update );
+  connect( mUI->exportButton, &QPushButton::clicked, this, &StatsTab::Export );
+  connect( UploadStats::Instance(), &UploadStats::Changed, this, &StatsTab::UpdateUploads );
+  connect( mUI->saveUploadStatsButton, &QPushButton::clicked, this, &StatsTab::SaveUploadStats );
+
+  Update();
+  UpdateUploads();
+}
+
+StatsTab::~StatsTab() {
+  delete mUI;
+}
+
+static QString FormatWinrate( const WinLoss& winLoss ) {
+  return QString( "%1% (%2)" ).arg( qRound( Winrate( winLoss ) * 100 ) ).arg( winLoss.games );
+}
+
+static QString FormatDuration( qint64 msecs ) {
+  if( msecs < 1000 )
+    return QString( "%1 ms" ).arg( msecs );
+  if( msecs < 60 * 1000 )
+    return QString( "%1 s" ).arg( msecs / 1000.0, 0, 'f', 1 );
+  return QString( "%1 min" ).arg( msecs / 60000 );
+}
+
+void StatsTab::Update() {
+  ResultFilter filter;
+  filter.mode = static_cast< GameMode >( mUI->modeFilter->currentData().toInt() );
+
+  WinLoss total = mResultStore->Total( filter );
+  QVector< WinLoss > orders = mResultStore->ByOrder( filter );
+  mUI->summaryLabel->setText( tr( "%1 games, %2 won. First: %3, second: %4" )
+      .arg( total.games )
+      .arg( FormatWinrate( total ) )
+      .arg( FormatWinrate( orders[ ORDER_FIRST ] ) )
+      .arg( FormatWinrate( orders[ ORDER_SECOND ] ) ) );
+
+  // Own class in rows, opponent in columns
+  QVector< WinLoss > matchups = mResultStore->ByMatchup( filter );
+  for( int hero = 0; hero < NUM_CLASSES; hero++ ) {
+    for( int opponent = 0; opponent < NUM_CLASSES; opponent++ ) {
+      const WinLoss& matchup = matchups[ hero * NUM_CLASSES + opponent ];
+      QTableWidgetItem *item = new QTableWidgetItem( matchup.games ? FormatWinrate( matchup ) : "" );
+      item->setTextAlignment( Qt::AlignCenter );
+      mUI->matchupTable->setItem( hero, opponent, item );
+    }
+  }
+
+  QStringList bands;
+  QMap< int, WinLoss > byRank = mResultStore->ByRankBand( filter, STATS_RANK_BAND );
+  for( auto it = byRank.constBegin(); it != byRank.constEnd(); ++it ) {
+    QString band = it.key() == 0 ? tr( "Legend" ) : tr( "Rank %1-%2" ).arg( it.key() ).arg( it.key() + STATS_RANK_BAND - 1 );
+    bands << band + ": " + FormatWinrate( it.value() );
+  }
+  mUI->rankLabel->setText( bands.join( ", " ) );
+}
+
+void StatsTab::Export() {
+  QString dir = QFileDialog::getExistingDirectory( this, tr( "Export games to" ),
+      QString(), QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks );
+  if( dir.isEmpty() )
+    return;
+
+  QApplication::setOverrideCursor( Qt::WaitCursor );
+  ResultExporter exporter( mResultStore );
+  bool exported = exporter.Export( dir );
+  QApplication::restoreOverrideCursor();
+
+  if( exported ) {
+    QMessageBox::information( this, tr( "Export finished" ),
+        tr( "%1 games and %2 cards played written to results.parquet and card_history.parquet" )
+        .arg( exporter.ExportedResults() ).arg( exporter.ExportedCards() ) );
+  } else {
+    QMessageBox::information( this, tr( "Export failed" ), tr( "Could not write to %1" ).arg( dir ) );
+  }
+}
+
+void StatsTab::UpdateUploads() {
+  const UploadStats *stats = UploadStats::Instance();
+
+  QStringList lines;
+  lines << tr( "Uploads: %1 results uploaded, %2 waiting, %3 rejected, %4 retries" )
+    .arg( stats->Uploaded() ).arg( stats->Backlog() ).arg( stats->Rejected() ).arg( stats->Retries() );
+
+  const Histogram& ackLatency = stats->AckLatency();
+  if( ackLatency.Count() ) {
+    lines << tr( "Game end to upload: median %1, 90% %2" )
+      .arg( FormatDuration( ackLatency.Percentile( 50 ) ) ).arg( FormatDuration( ackLatency.Percentile( 90 ) ) );
+  }
+
+  const Histogram& requestLatency = stats->RequestLatency();
+  if( requestLatency.Count() ) {
+    QStringList statusCodes;
+    for( auto it = stats->StatusCodes().constBegin(); it != stats->StatusCodes().constEnd(); ++it ) {
+      statusCodes << QString( "%1: %2" ).arg( it.key() ? QString::number( it.key() ) : tr( "no reply" ) ).arg( it.value() );
+    }
+    lines << tr( "%1 requests (%2), median %3, 90% %4, %5 KB sent" )
+      .arg( stats->Requests() )
+      .arg( statusCodes.join( ", " ) )
+      .arg( FormatDuration( requestLatency.Percentile( 50 ) ) )
+      .arg( FormatDuration( requestLatency.Percentile( 90 ) ) )
+      .arg( ( stats->BytesSent() + 1023 ) / 1024 );
+  }
+
+  mUI->uploadLabel->setText( lines.join( "\n" ) );
+}
+
+void StatsTab::SaveUploadStats() {
+  QString fileName = QFileDialog::getSaveFileName( this,
+      tr( "Save Upload Statistics" ), "upload-stats.json",
+      tr( "JSON (*.json);; All Files (*)" ) );
+  if( fileName.isEmpty() )
+    return;
+
+  QFile file( fileName );
+  if( !file.open( QIODevice::WriteOnly ) ) {
+    QMessageBox::information( this, tr( "Unable to open file" ), file.errorString() );
+    return;
+  }
+
+  file.write( QJsonDocument( UploadStats::Instance()->Snapshot() ).toJson() );
+  LOG( "Upload statistics saved to %s", qt2cstr( fileName ) );
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QWidget>
+
+#include "../ResultStore.h"
+
+namespace Ui { class StatsWidget; }
+
+class StatsTab : public QWidget
+{
+  Q_OBJECT
+
+private:
+  Ui::StatsWidget *mUI;
+  ResultStore *mResultStore;
+
+private slots:
+  void Update();
+  void Export();
+  void UpdateUploads();
+  void SaveUploadStats();
+
+public:
+  explicit StatsTab( ResultStore *resultStore, QWidget *parent = 0 );
+  ~StatsTab();
+};
@@ -11,7 +11,7 @@
 #include "../Settings.h"
 #include "../Hearthstone.h"
 
-Window::Window()
+Window::Window( ResultStore *resultStore )
   : mUI( new Ui::MainWindow )
 {
   mUI->setupUi( this );
@@ -33,21 +33,26 @@ Window::Window()
   mUI->actionAccount->setActionGroup( group );
   mUI->actionAccount->setProperty( "pageIndex", 1 );
 
+  mUI->actionStats->setActionGroup( group );
+  mUI->actionStats->setProperty( "pageIndex", 2 );
+
   mUI->actionLog->setActionGroup( group );
-  mUI->actionLog->setProperty( "pageIndex", 2 );
+  mUI->actionLog->setProperty( "pageIndex", 3 );
 
   mUI->actionAbout->setActionGroup( group );
-  mUI->actionAbout->setProperty( "pageIndex", 3 );
+  mUI->actionAbout->setProperty( "pageIndex", 4 );
 
   mSettingsTab = new SettingsTab( this );
   mAccountTab  = new AccountTab( this );
+  mStatsTab    = new StatsTab( resultStore, this );
   mLogTab      = new LogTab( this );
   mAboutTab    = new AboutTab( this );
 
   mTabs[ 0 ] = mSettingsTab;
   mTabs[ 1 ] = mAccountTab;
-  mTabs[ 2 ] = mLogTab;
-  mTabs[ 3 ] = mAboutTab;
+  mTabs[ 2 ] = mStatsTab;
+  mTabs[ 3 ] = mLogTab;
+  mTabs[ 4 ] = mAboutTab;
 
   QLayout *layout = mUI->mainWidget->layout();
   for( int i = 0; i < NUM_TABS; i++ ) {
@@ -11,10 +11,11 @@
 #include "AccountTab.h"
 #include "SettingsTab.h"
 #include "AboutTab.h"
+#include "StatsTab.h"
 
 namespace Ui { class MainWindow; }
 
-#define NUM_TABS 4
+#define NUM_TABS 5
 
 class Window : public QMainWindow
 {
@@ -37,6 +38,7 @@ private:
 
   SettingsTab       *mSettingsTab;
   AccountTab        *mAccountTab;
+  StatsTab          *mStatsTab;
   LogTab            *mLogTab;
   AboutTab          *mAboutTab;
 
@@ -63,7 +65,7 @@ signals:
   void OpenProfile();
 
 public:
-  explicit Window();
+  explicit Window( ResultStore *resultStore );
   ~Window();
 };
 
@@ -31,7 +31,24 @@ HEADERS = $$GTEST_HEADERS \
           $$GMOCK_HEADERS \
           src/Local.h \
           src/OSXWindowCapture.h \
-          src/Logger.h
+          src/Logger.h \
+          src/MLP.h \
+          src/RankClassifier.h \
+          src/LinuxProcessFinder.h \
+          src/ReplayWindowCapture.h \
+          src/ResultJournal.h \
+          src/ResultStore.h \
+          src/ResultExporter.h \
+          src/ParquetWriter.h \
+          src/ResultQueue.h \
+          src/ResultTracker.h \
+          src/UploadStats.h \
+          src/WebProfile.h \
+          src/Settings.h \
+          src/Metadata.h \
+          test/FakeWebservice.h \
+          test/QuantizableRankClassifier.h \
+          test/TestApplication.h
 
 SOURCES = $$GMOCKPATH/src/gmock-all.cc \
           $$GTESTPATH/src/gtest-all.cc \
@@ -39,4 +56,20 @@ SOURCES = $$GMOCKPATH/src/gmock-all.cc \
           test/*Test.cpp \
           src/OSXWindowCapture.cpp \
           src/Hearthstone.cpp \
-          src/Logger.cpp
+          src/Logger.cpp \
+          src/MLP.cpp \
+          src/RankClassifier.cpp \
+          src/LinuxProcessFinder.cpp \
+          src/ReplayWindowCapture.cpp \
+          src/ResultJournal.cpp \
+          src/ResultStore.cpp \
+          src/ResultExporter.cpp \
+          src/ParquetWriter.cpp \
+          src/ResultQueue.cpp \
+          src/ResultTracker.cpp \
+          src/UploadStats.cpp \
+          src/WebProfile.cpp \
+          src/Settings.cpp \
+          src/Autostart.cpp \
+          src/Metadata.cpp \
+          src/Local.cpp
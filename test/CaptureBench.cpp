@@ -0,0 +1,168 @@
+// Measure the latency of LinuxWindowCapture against QScreen::grabWindow
+// and of the game window discovery against one round trip per window
+//
+// Usage: capture_bench [--iterations N] [--dummy-windows N]
+//
+// Opens a window pretending to be Hearthstone (WM_CLASS Hearthstone.exe)
+// among a bunch of dummy windows, then looks it up and captures the rank
+// label region from it over and over
+
+#include "LinuxWindowCapture.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QScreen>
+#include <QWidget>
+#include <QX11Info>
+
+#include <xcb/xcb_icccm.h>
+
+#include <cstdio>
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+
+class PatternWidget : public QWidget {
+protected:
+  void paintEvent( QPaintEvent* ) {
+    QPainter painter( this );
+    for( int y = 0; y < height(); y += 16 ) {
+      for( int x = 0; x < width(); x += 16 ) {
+        painter.fillRect( x, y, 16, 16, QColor( x % 256, y % 256, ( x + y ) % 256 ) );
+      }
+    }
+  }
+};
+
+// Discovery as it used to be: blocking query_tree and get_wm_class per window
+static QList< xcb_window_t > ListWindowsSerial( xcb_window_t window ) {
+  QList< xcb_window_t > windows;
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  CScopedPointer< xcb_query_tree_reply_t > queryR( xcb_query_tree_reply( xcbConn, xcb_query_tree( xcbConn, window ), nullptr ) );
+  if( queryR ) {
+    xcb_window_t* children = xcb_query_tree_children( queryR.data() );
+    for( auto c = 0; c < xcb_query_tree_children_length( queryR.data() ); ++c ) {
+      windows << children[ c ];
+      windows << ListWindowsSerial( children[ c ] );
+    }
+  }
+  return windows;
+}
+
+static xcb_window_t FindWindowSerial( const char *wmClass ) {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  foreach( const xcb_window_t& win, ListWindowsSerial( QX11Info::appRootWindow() ) ) {
+    xcb_icccm_get_wm_class_reply_t wmClassR;
+    if( xcb_icccm_get_wm_class_reply( xcbConn, xcb_icccm_get_wm_class( xcbConn, win ), &wmClassR, nullptr ) ) {
+      bool found = !qstricmp( wmClassR.class_name, wmClass );
+      xcb_icccm_get_wm_class_reply_wipe( &wmClassR );
+      if( found )
+        return win;
+    }
+  }
+  return XCB_WINDOW_NONE;
+}
+
+// Top level windows with a few children each, like toolkit clients have
+static void CreateDummyWindows( int count ) {
+  xcb_connection_t* xcbConn = QX11Info::connection();
+  const char wmClass[] = "dummy\0Dummy";
+
+  QList< xcb_window_t > parents;
+  for( int n = 0; n < count; n++ ) {
+    xcb_window_t parent = ( n % 4 == 0 || parents.isEmpty() ) ? QX11Info::appRootWindow() : parents.last();
+    xcb_window_t win = xcb_generate_id( xcbConn );
+    xcb_create_window( xcbConn, XCB_COPY_FROM_PARENT, win, parent, 0, 0, 10, 10, 0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr );
+    xcb_icccm_set_wm_class( xcbConn, win, sizeof( wmClass ), wmClass );
+    if( parent == QX11Info::appRootWindow() )
+      parents << win;
+  }
+  xcb_flush( xcbConn );
+}
+
+template< typename F >
+static double MeasureMicroseconds( int iterations, F capture ) {
+  QElapsedTimer timer;
+  timer.start();
+  for( int n = 0; n < iterations; n++ ) {
+    capture();
+  }
+  return timer.nsecsElapsed() / 1000.0 / iterations;
+}
+
+int main( int argc, char **argv ) {
+  QApplication app( argc, argv );
+  app.setApplicationName( "Track-o-Bot" );
+  app.setOrganizationName( "spidy.ch" );
+
+  QStringList args = app.arguments();
+  int iterations = 1000;
+  int iterationsIdx = args.indexOf( "--iterations" );
+  if( iterationsIdx > 0 && iterationsIdx + 1 < args.size() ) {
+    iterations = args[ iterationsIdx + 1 ].toInt();
+  }
+
+  int dummyWindows = 500;
+  int dummyWindowsIdx = args.indexOf( "--dummy-windows" );
+  if( dummyWindowsIdx > 0 && dummyWindowsIdx + 1 < args.size() ) {
+    dummyWindows = args[ dummyWindowsIdx + 1 ].toInt();
+  }
+
+  CreateDummyWindows( dummyWindows );
+
+  PatternWidget widget;
+  widget.setGeometry( 0, 0, BENCH_WIDTH, BENCH_HEIGHT );
+  widget.show();
+
+  const char wmClass[] = "Hearthstone.exe\0Hearthstone.exe";
+  xcb_icccm_set_wm_class( QX11Info::connection(), widget.winId(), sizeof( wmClass ), wmClass );
+  xcb_flush( QX11Info::connection() );
+
+  LinuxWindowCapture capture;
+  QElapsedTimer timeout;
+  timeout.start();
+  while( !capture.WindowFound() ) {
+    app.processEvents();
+    if( timeout.elapsed() > 5000 ) {
+      printf( "Window not found, is an X server running?\n" );
+      return 1;
+    }
+  }
+  app.processEvents();
+
+  int lookups = qMax( 1, iterations / 10 );
+  xcb_window_t found = XCB_WINDOW_NONE, foundSerial = XCB_WINDOW_NONE;
+  double findUs = MeasureMicroseconds( lookups, [&]() {
+    found = LinuxWindowCapture::FindWindow( "Hearthstone.exe", "Hearthstone.exe" );
+  });
+  double findSerialUs = MeasureMicroseconds( lookups, [&]() {
+    foundSerial = FindWindowSerial( "Hearthstone.exe" );
+  });
+  printf( "FindWindow with %d dummy windows %8.1f us, serial %8.1f us, %s\n",
+      dummyWindows, findUs, findSerialUs, found == foundSerial ? "same window" : "DIFFERENT window" );
+
+  // Rank label region at 1920x1080 (see RankClassifier::CaptureLabel)
+  QList< QRect > regions;
+  regions << QRect( 32, 960, 40, 40 ) << QRect( 0, 0, 400, 300 ) << QRect( 0, 0, BENCH_WIDTH, BENCH_HEIGHT );
+
+  QScreen *screen = QGuiApplication::primaryScreen();
+  for( const QRect& r : regions ) {
+    QImage shm = capture.CaptureImage( r.x(), r.y(), r.width(), r.height() );
+    QImage grab = screen->grabWindow( widget.winId(), r.x(), r.y(), r.width(), r.height() )
+      .toImage().convertToFormat( QImage::Format_RGB32 );
+
+    double shmUs = MeasureMicroseconds( iterations, [&]() {
+      capture.CaptureImage( r.x(), r.y(), r.width(), r.height() );
+    });
+    double grabUs = MeasureMicroseconds( iterations, [&]() {
+      screen->grabWindow( widget.winId(), r.x(), r.y(), r.width(), r.height() ).toImage();
+    });
+
+    printf( "%4dx%-4d capture %8.1f us, grabWindow %8.1f us, pixels %s\n",
+        r.width(), r.height(), shmUs, grabUs, shm == grab ? "identical" : "DIFFER" );
+  }
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <functional>
+
+// Stand-in for the Track-o-Bot webservice on localhost
+// Answers every request through a handler, one request per connection
+class FakeWebservice
+{
+public:
+  typedef struct {
+    QString    path;
+    QByteArray headers;
+    QByteArray body;
+    qint64     time; // ms since the server started
+
+    QJsonObject Json() const { return QJsonDocument::fromJson( body ).object(); }
+  } Request;
+
+  typedef struct {
+    int        status;
+    QByteArray body;
+    QList< QPair< QByteArray, QByteArray > > headers;
+  } Response;
+
+  typedef std::function< Response( const Request& ) > Handler;
+
+  QList< Request > requests;
+  int connections;
+
+  FakeWebservice()
+    : connections( 0 ), mHolding( false )
+  {
+    mTimer.start();
+    mServer.listen( QHostAddress::LocalHost );
+    QObject::connect( &mServer, &QTcpServer::newConnection, [this]() {
+      while( mServer.hasPendingConnections() ) {
+        QTcpSocket *socket = mServer.nextPendingConnection();
+        connections++;
+        QObject::connect( socket, &QTcpSocket::readyRead, [this, socket]() { Read( socket ); } );
+        QObject::connect( socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater );
+      }
+    });
+  }
+
+  QString Url() const {
+    return QString( "http://127.0.0.1:%1" ).arg( mServer.serverPort() );
+  }
+
+  void SetHandler( const Handler& handler ) {
+    mHandler = handler;
+  }
+
+  // Keep requests unanswered until released, oldest first
+  void Hold() {
+    mHolding = true;
+  }
+
+  void Release( int count ) {
+    while( count-- > 0 && !mHeld.isEmpty() ) {
+      ReleaseAt( 0 );
+    }
+  }
+
+  void ReleaseAt( int index ) {
+    QPair< QTcpSocket*, Request > held = mHeld.takeAt( index );
+    Respond( held.first, held.second );
+  }
+
+  int NumHeld() const {
+    return mHeld.size();
+  }
+
+  const Request& Held( int index ) const {
+    return mHeld[ index ].second;
+  }
+
+  static Response Json( int status, const QJsonObject& json ) {
+    Response response = { status, QJsonDocument( json ).toJson( QJsonDocument::Compact ), {} };
+    return response;
+  }
+
+private:
+  QTcpServer mServer;
+  QElapsedTimer mTimer;
+  Handler mHandler;
+  bool mHolding;
+  QList< QPair< QTcpSocket*, Request > > mHeld;
+  QHash< QTcpSocket*, QByteArray > mBuffers;
+
+  void Read( QTcpSocket *socket ) {
+    QByteArray& buffer = mBuffers[ socket ];
+    buffer += socket->readAll();
+
+    int headerEnd = buffer.indexOf( "\r\n\r\n" );
+    if( headerEnd < 0 )
+      return;
+
+    QByteArray headers = buffer.left( headerEnd );
+    int contentLength = 0;
+    for( const QByteArray& line : headers.split( '\n' ) ) {
+      if( line.toLower().startsWith( "content-length:" ) ) {
+        contentLength = line.mid( 15 ).trimmed().toInt();
+      }
+    }
+
+    if( buffer.size() < headerEnd + 4 + contentLength )
+      return;
+
+    Request request;
+    request.path = QString::fromLatin1( headers.split( ' ' ).value( 1 ) );
+    request.headers = headers;
+    request.body = buffer.mid( headerEnd + 4, contentLength );
+    request.time = mTimer.elapsed();
+    requests << request;
+    mBuffers.remove( socket );
+
+    if( mHolding ) {
+      mHeld << qMakePair( socket, request );
+    } else {
+      Respond( socket, request );
+    }
+  }
+
+  void Respond( QTcpSocket *socket, const Request& request ) {
+    Response response = mHandler ? mHandler( request ) : Json( 404, QJsonObject() );
+
+    QByteArray reply = "HTTP/1.1 " + QByteArray::number( response.status ) + " Fake\r\n";
+    reply += "Content-Type: application/json\r\n";
+    reply += "Content-Length: " + QByteArray::number( response.body.size() ) + "\r\n";
+    for( const auto& header : response.headers ) {
+      reply += header.first + ": " + header.second + "\r\n";
+    }
+    reply += "Connection: close\r\n\r\n";
+    reply += response.body;
+
+    socket->write( reply );
+    socket->disconnectFromHost();
+  }
+};
@@ -0,0 +1,84 @@
+#include "LinuxProcessFinder.h"
+#include "gtest/gtest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+// Fake /proc in a temporary directory
+class LinuxProcessFinderTest : public ::testing::Test {
+public:
+  QTemporaryDir mProc;
+
+  void AddProcess( int pid, const QByteArray& comm, const QByteArray& cmdline = QByteArray() ) {
+    QString dir = mProc.path() + "/" + QString::number( pid );
+    QDir().mkpath( dir );
+
+    QFile commFile( dir + "/comm" );
+    commFile.open( QIODevice::WriteOnly );
+    commFile.write( comm + "\n" );
+
+    QFile cmdlineFile( dir + "/cmdline" );
+    cmdlineFile.open( QIODevice::WriteOnly );
+    cmdlineFile.write( cmdline );
+  }
+
+  void RemoveProcess( int pid ) {
+    QDir( mProc.path() + "/" + QString::number( pid ) ).removeRecursively();
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE( mProc.isValid() );
+    QDir().mkpath( mProc.path() + "/self" );
+    QDir().mkpath( mProc.path() + "/sys" );
+    AddProcess( 1, "systemd" );
+    AddProcess( 812, "Xorg" );
+  }
+};
+
+TEST_F(LinuxProcessFinderTest, FindsProcessByComm) {
+  AddProcess( 4242, "Hearthstone.exe" );
+
+  LinuxProcessFinder finder( "Hearthstone.exe", mProc.path() );
+  EXPECT_TRUE( finder.Available() );
+  EXPECT_TRUE( finder.Running() );
+  EXPECT_EQ( finder.Pid(), 4242 );
+}
+
+TEST_F(LinuxProcessFinderTest, FindsWineProcessByCommandLine) {
+  AddProcess( 1000, "wine-preloader", QByteArray( "/usr/bin/wine-preloader\0C:\\Program Files (x86)\\Hearthstone\\Hearthstone.exe\0", 75 ) );
+
+  LinuxProcessFinder finder( "Hearthstone.exe", mProc.path() );
+  EXPECT_TRUE( finder.Running() );
+  EXPECT_EQ( finder.Pid(), 1000 );
+}
+
+TEST_F(LinuxProcessFinderTest, IgnoresOtherWineProcesses) {
+  AddProcess( 1000, "wineserver", QByteArray( "/usr/bin/wineserver\0", 20 ) );
+  AddProcess( 1001, "wine-preloader", QByteArray( "C:\\Program Files (x86)\\Battle.net\\Battle.net.exe\0", 49 ) );
+
+  LinuxProcessFinder finder( "Hearthstone.exe", mProc.path() );
+  EXPECT_FALSE( finder.Running() );
+  EXPECT_EQ( finder.Pid(), 0 );
+}
+
+TEST_F(LinuxProcessFinderTest, NoticesWhenProcessStops) {
+  AddProcess( 4242, "Hearthstone.exe" );
+
+  LinuxProcessFinder finder( "Hearthstone.exe", mProc.path() );
+  EXPECT_TRUE( finder.Running() );
+
+  RemoveProcess( 4242 );
+  EXPECT_FALSE( finder.Running() );
+  EXPECT_EQ( finder.Pid(), 0 );
+
+  AddProcess( 5000, "Hearthstone.exe" );
+  EXPECT_TRUE( finder.Running() );
+  EXPECT_EQ( finder.Pid(), 5000 );
+}
+
+TEST_F(LinuxProcessFinderTest, UnavailableWithoutProc) {
+  LinuxProcessFinder finder( "Hearthstone.exe", mProc.path() + "/missing" );
+  EXPECT_FALSE( finder.Available() );
+  EXPECT_FALSE( finder.Running() );
+}
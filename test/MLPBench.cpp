@@ -0,0 +1,124 @@
+// Throughput of the shipped rank classifier model, fp32 vs int8
+//
+// Usage: mlp_bench [model] [--iterations N]
+//
+// The model defaults to data/rank_classifier.bin. Only the MLP is timed
+// (no capture, scaling or binarization), on a fixed binary input.
+// Which kernels run depends on the compiler flags, e.g. -mavx2 for AVX2
+
+#include "MLP.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#define MLP_BENCH_MODEL_MAGIC "TOBM"
+#define MLP_BENCH_MODEL_VERSION 1
+
+static uint32_t ReadUInt32( const char *data ) {
+  const uint8_t *bytes = reinterpret_cast< const uint8_t* >( data );
+  return bytes[ 0 ] | ( bytes[ 1 ] << 8 ) | ( bytes[ 2 ] << 16 ) | ( uint32_t( bytes[ 3 ] ) << 24 );
+}
+
+// Same format as RankClassifier::LoadMLP (dist/build_rank_classifier.rb)
+static bool LoadModel( const std::string& path, MLP::MultiLayerPerceptron *mlp ) {
+  std::ifstream file( path.c_str(), std::ios::binary );
+  std::vector< char > buffer( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+  const char *data = buffer.data();
+  const char *end = data + buffer.size();
+
+  if( buffer.size() < 12 || memcmp( data, MLP_BENCH_MODEL_MAGIC, 4 ) != 0 ||
+      ReadUInt32( data + 4 ) != MLP_BENCH_MODEL_VERSION )
+    return false;
+
+  uint32_t numLayers = ReadUInt32( data + 8 );
+  data += 12;
+
+  for( uint32_t i = 0; i < numLayers; i++ ) {
+    if( end - data < 12 )
+      return false;
+
+    MLP::LayerType type = ( MLP::LayerType )ReadUInt32( data );
+    int numInputs = ReadUInt32( data + 4 );
+    int numOutputs = ReadUInt32( data + 8 );
+    data += 12;
+
+    size_t numValues = size_t( numOutputs ) + size_t( numOutputs ) * numInputs;
+    if( size_t( end - data ) < numValues * 4 )
+      return false;
+
+    std::vector< float > values( numValues );
+    for( size_t j = 0; j < numValues; j++ ) {
+      uint32_t raw = ReadUInt32( data + j * 4 );
+      memcpy( &values[ j ], &raw, 4 );
+    }
+
+    mlp->AddLayer( type, numInputs, numOutputs, values.data(), values.data() + numOutputs );
+    data += numValues * 4;
+  }
+
+  return numLayers > 0;
+}
+
+static double Throughput( const MLP::MultiLayerPerceptron& mlp, const MLP::Vector& input, int iterations ) {
+  float checksum = 0.0f;
+  auto start = std::chrono::steady_clock::now();
+  for( int n = 0; n < iterations; n++ ) {
+    checksum += mlp.Compute( input ).front();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  if( checksum < 0.0f ) {
+    printf( "Invalid output\n" );
+  }
+  return iterations / std::chrono::duration< double >( end - start ).count();
+}
+
+int main( int argc, char **argv ) {
+  std::string path = "data/rank_classifier.bin";
+  int iterations = 20000;
+  for( int i = 1; i < argc; i++ ) {
+    if( !strcmp( argv[ i ], "--iterations" ) && i + 1 < argc ) {
+      iterations = atoi( argv[ ++i ] );
+    } else {
+      path = argv[ i ];
+    }
+  }
+
+  MLP::MultiLayerPerceptron fp32;
+  if( !LoadModel( path, &fp32 ) ) {
+    printf( "Could not load model %s\n", path.c_str() );
+    return 1;
+  }
+  MLP::MultiLayerPerceptron int8 = fp32;
+  int8.Quantize();
+
+  // About as many pixels set as in a binarized label
+  std::mt19937 random( 1337 );
+  std::bernoulli_distribution pixel( 0.2 );
+  MLP::Vector input( 28 * 28 );
+  for( float& value : input ) {
+    value = pixel( random ) ? 1.0f : 0.0f;
+  }
+
+  // Warm up, then alternate so both see the same clock and cache state
+  Throughput( fp32, input, iterations / 10 );
+  Throughput( int8, input, iterations / 10 );
+
+  double fp32Best = 0.0, int8Best = 0.0;
+  for( int pass = 0; pass < 5; pass++ ) {
+    fp32Best = std::max( fp32Best, Throughput( fp32, input, iterations ) );
+    int8Best = std::max( int8Best, Throughput( int8, input, iterations ) );
+  }
+
+  printf( "fp32: %.0f classifications/s, %d bytes\n", fp32Best, (int)fp32.WeightsSize() );
+  printf( "int8: %.0f classifications/s, %d bytes\n", int8Best, (int)int8.WeightsSize() );
+  printf( "int8 vs fp32: %+.0f%%\n", ( int8Best / fp32Best - 1.0 ) * 100.0 );
+  return 0;
+}
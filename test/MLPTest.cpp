@@ -0,0 +1,198 @@
+#include "MLP.h"
+#include "gtest/gtest.h"
+
+#include <math.h>
+
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+// Same topology as data/rank_classifier.json
+#define MLP_TEST_INPUTS 784
+#define MLP_TEST_HIDDEN 128
+#define MLP_TEST_OUTPUTS 25
+
+#define MLP_TEST_TOLERANCE 1e-5f
+#define MLP_TEST_QUANTIZED_TOLERANCE 0.02f
+
+class MLPTest : public ::testing::Test {
+public:
+  std::mt19937 mRandom;
+  std::vector< MLP::Layer > mLayers;
+  MLP::MultiLayerPerceptron mMLP;
+
+  MLP::Layer RandomLayer( MLP::LayerType type, int numInputs, int numOutputs ) {
+    std::normal_distribution< float > dist( 0.0f, 0.1f );
+
+    MLP::Layer layer;
+    layer.type = type;
+    layer.biases.resize( numOutputs );
+    std::generate( layer.biases.begin(), layer.biases.end(), [&]() { return dist( mRandom ); } );
+    layer.weights.resize( numOutputs, MLP::Vector( numInputs ) );
+    for( MLP::Vector& row : layer.weights ) {
+      std::generate( row.begin(), row.end(), [&]() { return dist( mRandom ); } );
+    }
+    return layer;
+  }
+
+  MLP::Vector RandomBinaryInput() {
+    std::bernoulli_distribution dist( 0.2 );
+    MLP::Vector input( MLP_TEST_INPUTS );
+    std::generate( input.begin(), input.end(), [&]() { return dist( mRandom ) ? 1.0f : 0.0f; } );
+    return input;
+  }
+
+  // Straightforward implementation the MLP is checked against
+  MLP::Vector Reference( const MLP::Vector& input ) {
+    MLP::Vector res = input;
+    for( const MLP::Layer& layer : mLayers ) {
+      MLP::Vector z( layer.biases.size() );
+      for( size_t i = 0; i < z.size(); i++ ) {
+        z[ i ] = std::inner_product( layer.weights[ i ].begin(), layer.weights[ i ].end(), res.begin(), layer.biases[ i ] );
+      }
+
+      if( layer.type == MLP::LAYER_RECTIFIER ) {
+        for( float& zi : z ) zi = std::max( 0.0f, zi );
+      } else if( layer.type == MLP::LAYER_SIGMOID ) {
+        for( float& zi : z ) zi = 1.0f / ( 1.0f + expf( -zi ) );
+      } else if( layer.type == MLP::LAYER_SOFTMAX ) {
+        float m = *std::max_element( z.begin(), z.end() );
+        float sum = 0.0f;
+        for( float zi : z ) sum += expf( zi - m );
+        for( float& zi : z ) zi = expf( zi - m ) / sum;
+      }
+      res = z;
+    }
+    return res;
+  }
+
+  virtual void SetUp() {
+    mRandom.seed( 1337 );
+    mLayers.push_back( RandomLayer( MLP::LAYER_RECTIFIER, MLP_TEST_INPUTS, MLP_TEST_HIDDEN ) );
+    mLayers.push_back( RandomLayer( MLP::LAYER_SOFTMAX, MLP_TEST_HIDDEN, MLP_TEST_OUTPUTS ) );
+    for( const MLP::Layer& layer : mLayers ) {
+      mMLP.AddLayer( layer );
+    }
+  }
+};
+
+TEST_F(MLPTest, DotHandlesPaddedRows) {
+  MLP::AlignedVector a( 24, 0.0f ), b( 24, 0.0f );
+  for( int i = 0; i < 21; i++ ) {
+    a[ i ] = i;
+    b[ i ] = 2.0f;
+  }
+  EXPECT_FLOAT_EQ( MLP::MultiLayerPerceptron::Dot( a.data(), b.data(), 24 ), 420.0f );
+}
+
+TEST_F(MLPTest, PaddedSize) {
+  EXPECT_EQ( MLP::MultiLayerPerceptron::PaddedSize( 784 ), 784 );
+  EXPECT_EQ( MLP::MultiLayerPerceptron::PaddedSize( 25 ), 32 );
+  EXPECT_EQ( MLP::MultiLayerPerceptron::PaddedSize( 1 ), 8 );
+}
+
+TEST_F(MLPTest, ComputeMatchesReference) {
+  for( int n = 0; n < 50; n++ ) {
+    MLP::Vector input = RandomBinaryInput();
+    MLP::Vector expected = Reference( input );
+    MLP::Vector actual = mMLP.Compute( input );
+
+    ASSERT_EQ( actual.size(), expected.size() );
+    for( size_t i = 0; i < actual.size(); i++ ) {
+      EXPECT_NEAR( actual[ i ], expected[ i ], MLP_TEST_TOLERANCE );
+    }
+  }
+}
+
+TEST_F(MLPTest, ComputeBatchMatchesCompute) {
+  MLP::MultiLayerPerceptron quantized = mMLP;
+  quantized.Quantize();
+
+  MLP::Matrix inputs;
+  for( int n = 0; n < 9; n++ ) {
+    inputs.push_back( RandomBinaryInput() );
+  }
+
+  MLP::Matrix outputs = mMLP.ComputeBatch( inputs );
+  MLP::Matrix quantizedOutputs = quantized.ComputeBatch( inputs );
+  ASSERT_EQ( outputs.size(), inputs.size() );
+  ASSERT_EQ( quantizedOutputs.size(), inputs.size() );
+
+  for( size_t n = 0; n < inputs.size(); n++ ) {
+    MLP::Vector expected = mMLP.Compute( inputs[ n ] );
+    for( size_t i = 0; i < expected.size(); i++ ) {
+      EXPECT_NEAR( outputs[ n ][ i ], expected[ i ], MLP_TEST_TOLERANCE );
+    }
+    EXPECT_EQ( quantizedOutputs[ n ], quantized.Compute( inputs[ n ] ) );
+  }
+}
+
+TEST_F(MLPTest, DotQuantized) {
+  MLP::AlignedQuantizedVector a( 64, 0 );
+  MLP::AlignedQuantizedInputVector b( 64, 0 );
+  int32_t expected = 0;
+  for( int i = 0; i < 50; i++ ) {
+    a[ i ] = ( i % 2 ) ? -127 : 127;
+    b[ i ] = 127 - i;
+    expected += int32_t( a[ i ] ) * int32_t( b[ i ] );
+  }
+  EXPECT_EQ( MLP::MultiLayerPerceptron::DotQuantized( a.data(), b.data(), 64 ), expected );
+}
+
+// Decisions on the shipped model: RankClassifierTest
+TEST_F(MLPTest, QuantizedStaysCloseToFp32) {
+  MLP::MultiLayerPerceptron quantized = mMLP;
+  quantized.Quantize();
+
+  EXPECT_TRUE( quantized.Quantized() );
+  EXPECT_LT( quantized.WeightsSize() * 3, mMLP.WeightsSize() );
+
+  for( int n = 0; n < 200; n++ ) {
+    MLP::Vector input = RandomBinaryInput();
+    MLP::Vector expected = mMLP.Compute( input );
+    MLP::Vector actual = quantized.Compute( input );
+
+    ASSERT_EQ( actual.size(), expected.size() );
+    for( size_t i = 0; i < actual.size(); i++ ) {
+      EXPECT_NEAR( actual[ i ], expected[ i ], MLP_TEST_QUANTIZED_TOLERANCE );
+    }
+  }
+}
+
+static double Throughput( const MLP::MultiLayerPerceptron& mlp, const MLP::Vector& input ) {
+  const int iterations = 2000;
+
+  auto start = std::chrono::steady_clock::now();
+  float checksum = 0.0f;
+  for( int n = 0; n < iterations; n++ ) {
+    checksum += mlp.Compute( input ).front();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_GT( checksum, 0.0f );
+  return iterations / std::chrono::duration< double >( end - start ).count();
+}
+
+TEST_F(MLPTest, Throughput) {
+  MLP::Vector input = RandomBinaryInput();
+
+  MLP::MultiLayerPerceptron quantized = mMLP;
+  quantized.Quantize();
+
+  printf( "MLP: %.0f classifications/s (fp32)\n", Throughput( mMLP, input ) );
+  printf( "MLP: %.0f classifications/s (int8)\n", Throughput( quantized, input ) );
+
+  const int batchSize = 9;
+  const int iterations = 2000 / batchSize;
+  MLP::Matrix inputs( batchSize, input );
+
+  auto start = std::chrono::steady_clock::now();
+  for( int n = 0; n < iterations; n++ ) {
+    mMLP.ComputeBatch( inputs );
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration< double >( end - start ).count();
+  printf( "MLP: %.0f classifications/s (fp32, batches of %d)\n", iterations * batchSize / seconds, batchSize );
+}
@@ -0,0 +1,171 @@
+#include "ParquetWriter.h"
+#include "gtest/gtest.h"
+
+#include <random>
+#include <sstream>
+
+class ParquetWriterTest : public ::testing::Test {
+public:
+  static uint64_t Varint( const std::string& data, size_t& pos ) {
+    uint64_t value = 0;
+    for( int shift = 0; pos < data.size(); shift += 7 ) {
+      uint8_t byte = data[ pos++ ];
+      value |= uint64_t( byte & 0x7F ) << shift;
+      if( !( byte & 0x80 ) )
+        break;
+    }
+    return value;
+  }
+
+  static int64_t ZigZagVarint( const std::string& data, size_t& pos ) {
+    uint64_t value = Varint( data, pos );
+    return int64_t( value >> 1 ) ^ -int64_t( value & 1 );
+  }
+
+  static uint64_t Unpack( const std::string& data, size_t pos, size_t index, int bitWidth ) {
+    uint64_t value = 0;
+    for( int b = 0; b < bitWidth; b++ ) {
+      size_t bit = index * bitWidth + b;
+      if( ( uint8_t( data[ pos + bit / 8 ] ) >> ( bit % 8 ) ) & 1 ) {
+        value |= uint64_t( 1 ) << b;
+      }
+    }
+    return value;
+  }
+
+  // Reference decoder for DELTA_BINARY_PACKED, straight from the spec
+  // INT32 columns wrap at 32 bits and allow at most 32 bits per delta
+  static std::vector< int64_t > DecodeDelta( const std::string& data, bool int32 = false ) {
+    size_t pos = 0;
+    uint64_t blockSize = Varint( data, pos );
+    uint64_t miniblocks = Varint( data, pos );
+    uint64_t count = Varint( data, pos );
+    int64_t value = ZigZagVarint( data, pos );
+
+    std::vector< int64_t > values;
+    if( count == 0 )
+      return values;
+    values.push_back( value );
+
+    uint64_t miniblockSize = blockSize / miniblocks;
+    while( values.size() < count ) {
+      int64_t minDelta = ZigZagVarint( data, pos );
+      std::vector< int > bitWidths;
+      for( uint64_t m = 0; m < miniblocks; m++ ) {
+        bitWidths.push_back( uint8_t( data[ pos++ ] ) );
+        if( int32 && bitWidths.back() > 32 )
+          return std::vector< int64_t >();
+      }
+      for( uint64_t m = 0; m < miniblocks && values.size() < count; m++ ) {
+        for( uint64_t i = 0; i < miniblockSize && values.size() < count; i++ ) {
+          if( int32 ) {
+            value = int32_t( uint32_t( value ) + uint32_t( minDelta ) + uint32_t( Unpack( data, pos, i, bitWidths[ m ] ) ) );
+          } else {
+            value = int64_t( uint64_t( value ) + uint64_t( minDelta ) + Unpack( data, pos, i, bitWidths[ m ] ) );
+          }
+          values.push_back( value );
+        }
+        pos += miniblockSize * bitWidths[ m ] / 8;
+      }
+    }
+    return values;
+  }
+};
+
+TEST_F(ParquetWriterTest, WritesMagicAndFooter) {
+  std::ostringstream out;
+  ParquetWriter writer( out );
+  int id = writer.AddColumn( "id", ParquetWriter::COLUMN_INT32 );
+  int name = writer.AddColumn( "name", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  for( int i = 0; i < 10; i++ ) {
+    writer.Append( id, int64_t( i ) );
+    writer.Append( name, std::string( "mage" ) );
+  }
+  EXPECT_EQ( writer.BufferedRows(), 10 );
+  writer.FlushRowGroup();
+  EXPECT_EQ( writer.BufferedRows(), 0 );
+  writer.Append( id, int64_t( 10 ) );
+  writer.Append( name, std::string( "rogue" ) );
+  ASSERT_TRUE( writer.Close() );
+  EXPECT_EQ( writer.NumRows(), 11 );
+
+  std::string file = out.str();
+  ASSERT_GT( file.size(), 12u );
+  EXPECT_EQ( file.substr( 0, 4 ), "PAR1" );
+  EXPECT_EQ( file.substr( file.size() - 4 ), "PAR1" );
+
+  const uint8_t *length = reinterpret_cast< const uint8_t* >( file.data() + file.size() - 8 );
+  uint32_t footerSize = length[ 0 ] | ( length[ 1 ] << 8 ) | ( length[ 2 ] << 16 ) | ( uint32_t( length[ 3 ] ) << 24 );
+  EXPECT_LT( footerSize, file.size() - 12 );
+  std::string footer = file.substr( file.size() - 8 - footerSize, footerSize );
+  EXPECT_NE( footer.find( "name" ), std::string::npos );
+  EXPECT_NE( footer.find( "Track-o-Bot" ), std::string::npos );
+}
+
+TEST_F(ParquetWriterTest, EmptyFileIsValid) {
+  std::ostringstream out;
+  ParquetWriter writer( out );
+  writer.AddColumn( "added", ParquetWriter::COLUMN_TIMESTAMP, ParquetWriter::ENCODING_DELTA );
+  ASSERT_TRUE( writer.Close() );
+
+  std::string file = out.str();
+  EXPECT_EQ( file.substr( 0, 4 ), "PAR1" );
+  EXPECT_EQ( file.substr( file.size() - 4 ), "PAR1" );
+}
+
+TEST_F(ParquetWriterTest, DeltaEncodingRoundTrips) {
+  std::mt19937_64 random( 1337 );
+
+  std::vector< int64_t > timestamps;
+  int64_t t = 1767268800000LL;
+  for( int i = 0; i < 1000; i++ ) {
+    t += random() % 3600000;
+    timestamps.push_back( t );
+  }
+  EXPECT_EQ( DecodeDelta( ParquetWriter::EncodeDelta( timestamps ) ), timestamps );
+
+  // Ascending timestamps take a couple of bytes each instead of 8
+  EXPECT_LT( ParquetWriter::EncodeDelta( timestamps ).size(), timestamps.size() * 3 );
+
+  std::vector< int64_t > extremes = { INT64_MAX, INT64_MIN, 0, -1, INT64_MIN, INT64_MAX, 42 };
+  EXPECT_EQ( DecodeDelta( ParquetWriter::EncodeDelta( extremes ) ), extremes );
+
+  for( size_t size : { 0, 1, 2, 33, 128, 129, 257 } ) {
+    std::vector< int64_t > values;
+    for( size_t i = 0; i < size; i++ ) {
+      values.push_back( int64_t( random() % 1000 ) - 500 );
+    }
+    EXPECT_EQ( DecodeDelta( ParquetWriter::EncodeDelta( values ) ), values ) << size << " values";
+  }
+}
+
+TEST_F(ParquetWriterTest, DeltaEncodingRoundTripsInt32) {
+  std::vector< int64_t > extremes = { INT32_MAX, INT32_MIN, INT32_MAX, 0, INT32_MIN, -1, INT32_MIN, INT32_MAX, 42 };
+  EXPECT_EQ( DecodeDelta( ParquetWriter::EncodeDelta( extremes, ParquetWriter::COLUMN_INT32 ), true ), extremes );
+
+  std::mt19937 random( 1337 );
+  std::vector< int64_t > values;
+  for( int i = 0; i < 1000; i++ ) {
+    values.push_back( int32_t( random() ) );
+  }
+  EXPECT_EQ( DecodeDelta( ParquetWriter::EncodeDelta( values, ParquetWriter::COLUMN_INT32 ), true ), values );
+}
+
+TEST_F(ParquetWriterTest, DictionaryEncodingIsCompact) {
+  static const char *cards[] = { "CS2_029", "CS2_032", "EX1_277", "NEW1_012", "CS2_024" };
+
+  std::ostringstream plainOut, dictionaryOut;
+  ParquetWriter plain( plainOut );
+  ParquetWriter dictionary( dictionaryOut );
+  int plainColumn = plain.AddColumn( "card_id", ParquetWriter::COLUMN_STRING );
+  int dictionaryColumn = dictionary.AddColumn( "card_id", ParquetWriter::COLUMN_STRING, ParquetWriter::ENCODING_DICTIONARY );
+  for( int i = 0; i < 10000; i++ ) {
+    plain.Append( plainColumn, std::string( cards[ i % 5 ] ) );
+    dictionary.Append( dictionaryColumn, std::string( cards[ i % 5 ] ) );
+  }
+  ASSERT_TRUE( plain.Close() );
+  ASSERT_TRUE( dictionary.Close() );
+
+  // 3 bits per value vs 4 + 7 bytes
+  EXPECT_LT( dictionaryOut.str().size() * 20, plainOut.str().size() );
+}
@@ -0,0 +1,131 @@
+// Measure speed and accuracy of the rank classifier on recorded labels
+//
+// Usage: rank_bench <directory> [--quantized] [--passes N]
+//
+// The directory contains one subdirectory per rank (1-25) with PNG crops
+// as returned by RankClassifier::CaptureLabel, plus 0 for crops without
+// a readable rank (the classifier should return RANK_UNKNOWN for those)
+
+#include "RankClassifier.h"
+#include "Result.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <cstdio>
+#include <vector>
+
+#include "QuantizableRankClassifier.h"
+
+typedef struct {
+  int rank;
+  QImage image;
+} LabeledCrop;
+
+static QList< LabeledCrop > LoadCrops( const QString& path ) {
+  QList< LabeledCrop > crops;
+
+  for( int rank = RANK_UNKNOWN; rank <= RC_NUM_RANKS; rank++ ) {
+    QDirIterator it( QString( "%1/%2" ).arg( path ).arg( rank ), QStringList() << "*.png" );
+    while( it.hasNext() ) {
+      LabeledCrop crop;
+      crop.rank = rank;
+      crop.image = QImage( it.next() );
+      if( !crop.image.isNull() ) {
+        crops << crop;
+      }
+    }
+  }
+
+  return crops;
+}
+
+int main( int argc, char **argv ) {
+  QCoreApplication app( argc, argv );
+  app.setApplicationName( "Track-o-Bot" );
+  app.setOrganizationName( "spidy.ch" );
+
+  QStringList args = app.arguments();
+  if( args.size() < 2 ) {
+    printf( "Usage: %s <directory> [--quantized] [--passes N]\n", qPrintable( args.first() ) );
+    return 1;
+  }
+
+  bool quantized = args.contains( "--quantized" );
+  int passes = 10;
+  int passesIdx = args.indexOf( "--passes" );
+  if( passesIdx > 0 && passesIdx + 1 < args.size() ) {
+    passes = args[ passesIdx + 1 ].toInt();
+  }
+
+  QList< LabeledCrop > crops = LoadCrops( args[ 1 ] );
+  if( crops.isEmpty() ) {
+    printf( "No crops found in %s\n", qPrintable( args[ 1 ] ) );
+    return 1;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  QuantizableRankClassifier classifier( quantized );
+  classifier.SetCacheEnabled( false );
+  printf( "Model: %s, %d bytes, loaded in %lld ms\n",
+      quantized ? "int8" : "fp32", (int)classifier.ModelSize(), timer.elapsed() );
+
+  // Accuracy
+  // confusion[ truth ][ predicted ], predicted 0 means rejected
+  std::vector< std::vector< int > > confusion( RC_NUM_RANKS + 1, std::vector< int >( RC_NUM_RANKS + 1, 0 ) );
+  int correct = 0, rejected = 0, falsePositives = 0;
+
+  for( const LabeledCrop& crop : crops ) {
+    float score;
+    int predicted = classifier.Classify( crop.image, &score, NULL );
+    confusion[ crop.rank ][ predicted ]++;
+
+    if( predicted == crop.rank ) {
+      correct++;
+    } else if( predicted == RANK_UNKNOWN ) {
+      rejected++;
+    } else {
+      // Confident, but wrong: this is what ends up in the uploaded result
+      falsePositives++;
+    }
+  }
+
+  printf( "\nConfusion matrix (rows: truth, columns: predicted, 0 = unknown)\n    " );
+  for( int p = 0; p <= RC_NUM_RANKS; p++ ) {
+    printf( "%4d", p );
+  }
+  printf( "\n" );
+  for( int t = 0; t <= RC_NUM_RANKS; t++ ) {
+    printf( "%4d", t );
+    for( int p = 0; p <= RC_NUM_RANKS; p++ ) {
+      printf( "%4d", confusion[ t ][ p ] );
+    }
+    printf( "\n" );
+  }
+
+  int total = crops.size();
+  printf( "\n%d crops: %.2f%% correct, %.2f%% rejected, %.2f%% false positives at threshold %.2f\n",
+      total,
+      100.0 * correct / total,
+      100.0 * rejected / total,
+      100.0 * falsePositives / total,
+      RC_PROBA_THRESHOLD );
+
+  // Throughput (scale + binarize + MLP, like Classify on a captured label)
+  timer.restart();
+  int classified = 0;
+  for( int pass = 0; pass < passes; pass++ ) {
+    for( const LabeledCrop& crop : crops ) {
+      classifier.Classify( crop.image, NULL, NULL );
+      classified++;
+    }
+  }
+  qint64 elapsed = std::max< qint64 >( timer.elapsed(), 1 );
+  printf( "%d classifications in %lld ms: %.0f classifications/s\n",
+      classified, elapsed, classified * 1000.0 / elapsed );
+
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include "RankClassifier.h"
+#include "gtest/gtest.h"
+
+#include <QColor>
+
+#include <cmath>
+#include <random>
+
+#include "QuantizableRankClassifier.h"
+
+#define RC_TEST_MAX_SATURATION 5
+#define RC_TEST_MIN_VALUE 50
+
+// Quantized decisions may only flip for scores this close to RC_PROBA_THRESHOLD
+#define RC_TEST_QUANTIZED_THRESHOLD_MARGIN 0.005
+
+// Original QColor based implementation, the kernel has to match it bit by bit
+static MLP::Vector ReferenceBinarizeImageSV( const QImage& img, float maxSaturation, float minValue ) {
+  MLP::Vector bin( img.width() * img.height() );
+
+  float sumX = 0.0f;
+  float sumY = 0.0f;
+  int area = 0;
+
+  for( int y = 0; y < img.height(); y++ ) {
+    for( int x = 0; x < img.width(); x++ ) {
+      int idx = y * img.width() + x;
+
+      int h, s, v;
+      QColor( img.pixel( x, y ) ).getHsv( &h, &s, &v );
+
+      s = int(float(s) / 255.0f * 100.0f);
+      v = int(float(v) / 255.0f * 100.0f);
+
+      bool white = ( s <= maxSaturation && v >= minValue );
+      bin[ idx ] = white ? 1.0f : 0.0f;
+
+      if( white ) {
+        sumX += (float(x) + 0.5f);
+        sumY += (float(y) + 0.5f);
+        area++;
+      }
+    }
+  }
+
+  MLP::Vector binCentered( img.width() * img.height(), 0.0f );
+
+  float gravityX = area ? sumX / area : img.width() * 0.5f;
+  float gravityY = area ? sumY / area : img.height() * 0.5f;
+
+  int offsetX = std::round(img.width() * 0.5f - gravityX);
+  int offsetY = std::round(img.height() * 0.5f - gravityY);
+
+  for( int y = 0; y < img.height(); y++ ) {
+    for( int x = 0; x < img.width(); x++ ) {
+      int newX = x + offsetX;
+      int newY = y + offsetY;
+
+      if( newX >= 0 && newX < img.width() && newY >= 0 && newY < img.height() ) {
+        binCentered[ newY * img.width() + newX ] = bin[ y * img.width() + x ];
+      }
+    }
+  }
+
+  return binCentered;
+}
+
+class RankClassifierTest : public ::testing::Test {
+public:
+  std::mt19937 mRandom;
+
+  // Mostly dark background with a bright, slightly tinted blob
+  QImage RandomLabel( int width, int height ) {
+    std::uniform_int_distribution< int > channel( 0, 255 );
+    std::uniform_int_distribution< int > tint( -20, 20 );
+    std::uniform_int_distribution< int > pos( 0, width - 1 );
+
+    QImage img( width, height, QImage::Format_RGB32 );
+    for( int y = 0; y < height; y++ ) {
+      for( int x = 0; x < width; x++ ) {
+        int c = channel( mRandom ) / 3;
+        img.setPixel( x, y, qRgb( c, qBound( 0, c + tint( mRandom ), 255 ), c ) );
+      }
+    }
+
+    int cx = pos( mRandom ), cy = pos( mRandom );
+    for( int y = 0; y < height; y++ ) {
+      for( int x = 0; x < width; x++ ) {
+        if( abs( x - cx ) + abs( y - cy ) < width / 4 ) {
+          int c = 100 + channel( mRandom ) * 155 / 255;
+          img.setPixel( x, y, qRgb( qBound( 0, c + tint( mRandom ), 255 ), c, qBound( 0, c + tint( mRandom ), 255 ) ) );
+        }
+      }
+    }
+
+    return img;
+  }
+
+  // White rank digits (5x7 font scaled up) on a dark badge, some pixels flipped
+  QImage DigitLabel( int rank, int scale, double noise ) {
+    static const char *font[ 10 ][ 7 ] = {
+      { "01110", "10001", "10011", "10101", "11001", "10001", "01110" },
+      { "00100", "01100", "00100", "00100", "00100", "00100", "01110" },
+      { "01110", "10001", "00001", "00010", "00100", "01000", "11111" },
+      { "11111", "00010", "00100", "00010", "00001", "10001", "01110" },
+      { "00010", "00110", "01010", "10010", "11111", "00010", "00010" },
+      { "11111", "10000", "11110", "00001", "00001", "10001", "01110" },
+      { "00110", "01000", "10000", "11110", "10001", "10001", "01110" },
+      { "11111", "00001", "00010", "00100", "01000", "01000", "01000" },
+      { "01110", "10001", "10001", "01110", "10001", "10001", "01110" },
+      { "01110", "10001", "10001", "01111", "00001", "00010", "01100" }
+    };
+    std::uniform_int_distribution< int > shift( -1, 1 );
+    std::bernoulli_distribution flip( noise );
+
+    QList< int > digits;
+    if( rank >= 10 ) {
+      digits << rank / 10;
+    }
+    digits << rank % 10;
+
+    QImage img( 28, 28, QImage::Format_RGB32 );
+    img.fill( qRgb( 40, 30, 60 ) );
+
+    int ox = ( 28 - ( digits.size() * 6 - 1 ) * scale ) / 2 + shift( mRandom );
+    int oy = ( 28 - 7 * scale ) / 2 + shift( mRandom );
+    for( int d = 0; d < digits.size(); d++ ) {
+      for( int y = 0; y < 7 * scale; y++ ) {
+        for( int x = 0; x < 5 * scale; x++ ) {
+          int px = ox + ( d * 6 ) * scale + x, py = oy + y;
+          if( font[ digits[ d ] ][ y / scale ][ x / scale ] == '1' && img.rect().contains( px, py ) ) {
+            img.setPixel( px, py, qRgb( 255, 255, 255 ) );
+          }
+        }
+      }
+    }
+
+    for( int y = 0; y < 28; y++ ) {
+      for( int x = 0; x < 28; x++ ) {
+        if( flip( mRandom ) ) {
+          img.setPixel( x, y, img.pixel( x, y ) == qRgb( 255, 255, 255 ) ? qRgb( 40, 30, 60 ) : qRgb( 255, 255, 255 ) );
+        }
+      }
+    }
+
+    return img;
+  }
+
+  virtual void SetUp() {
+    mRandom.seed( 42 );
+  }
+};
+
+TEST_F(RankClassifierTest, BinarizeMatchesReferenceForAllColors) {
+  // Every (max, min) channel combination once, in 64x64 tiles
+  // (larger images would exceed the float precision of the reference centroid)
+  for( int tile = 0; tile < 16; tile++ ) {
+    QImage img( 64, 64, QImage::Format_RGB32 );
+    for( int y = 0; y < 64; y++ ) {
+      for( int x = 0; x < 64; x++ ) {
+        int r = ( tile % 4 ) * 64 + x;
+        int g = ( tile / 4 ) * 64 + y;
+        img.setPixel( x, y, qRgb( r, g, std::min( r, g ) ) );
+      }
+    }
+
+    EXPECT_EQ( RankClassifier::BinarizeImageSV( img, RC_TEST_MAX_SATURATION, RC_TEST_MIN_VALUE ),
+        ReferenceBinarizeImageSV( img, RC_TEST_MAX_SATURATION, RC_TEST_MIN_VALUE ) );
+  }
+}
+
+TEST_F(RankClassifierTest, BinarizeMatchesReferenceForLabels) {
+  const QImage::Format formats[] = {
+    QImage::Format_RGB32,
+    QImage::Format_ARGB32,
+    QImage::Format_ARGB32_Premultiplied,
+    QImage::Format_RGB888
+  };
+
+  for( int n = 0; n < 200; n++ ) {
+    QImage img = RandomLabel( 28, 28 ).convertToFormat( formats[ n % 4 ] );
+
+    EXPECT_EQ( RankClassifier::BinarizeImageSV( img, RC_TEST_MAX_SATURATION, RC_TEST_MIN_VALUE ),
+        ReferenceBinarizeImageSV( img, RC_TEST_MAX_SATURATION, RC_TEST_MIN_VALUE ) );
+  }
+}
+
+TEST_F(RankClassifierTest, BinarizeEmptyImage) {
+  QImage img( 28, 28, QImage::Format_RGB32 );
+  img.fill( Qt::black );
+
+  MLP::Vector bin = RankClassifier::BinarizeImageSV( img, RC_TEST_MAX_SATURATION, RC_TEST_MIN_VALUE );
+  EXPECT_EQ( bin, MLP::Vector( 28 * 28, 0.0f ) );
+}
+
+// Shipped model: int8 and fp32 report the same rank, unless the
+// score is right at the threshold (why int8 is not a setting)
+TEST_F(RankClassifierTest, QuantizedDecisionsDifferOnlyAtThreshold) {
+  QuantizableRankClassifier classifier( false );
+  QuantizableRankClassifier quantized( true );
+  classifier.SetCacheEnabled( false );
+  quantized.SetCacheEnabled( false );
+  EXPECT_LT( quantized.ModelSize() * 3, classifier.ModelSize() );
+
+  int confident = 0, flipped = 0, samples = 0;
+  for( int rank = 1; rank <= RC_NUM_RANKS; rank++ ) {
+    for( int scale = 2; scale <= 3; scale++ ) {
+      for( double noise : { 0.0, 0.01, 0.03, 0.06 } ) {
+        for( int n = 0; n < 10; n++ ) {
+          QImage label = DigitLabel( rank, scale, noise );
+
+          float score, quantizedScore;
+          int expected = classifier.Classify( label, &score, NULL );
+          int actual = quantized.Classify( label, &quantizedScore, NULL );
+          samples++;
+          confident += expected != 0;
+
+          if( actual != expected ) {
+            flipped++;
+            EXPECT_TRUE( expected == 0 || actual == 0 ) << "rank " << rank;
+            EXPECT_NEAR( score, RC_PROBA_THRESHOLD, RC_TEST_QUANTIZED_THRESHOLD_MARGIN ) << "rank " << rank;
+            EXPECT_NEAR( quantizedScore, RC_PROBA_THRESHOLD, RC_TEST_QUANTIZED_THRESHOLD_MARGIN ) << "rank " << rank;
+          }
+        }
+      }
+    }
+  }
+
+  printf( "RankClassifier: %d/%d labels confident, %d decisions flipped by int8\n", confident, samples, flipped );
+  EXPECT_GT( confident, 0 );
+}
@@ -0,0 +1,106 @@
+#include "ReplayWindowCapture.h"
+#include "gtest/gtest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+#include "TestApplication.h"
+
+class ReplayWindowCaptureTest : public TestApplication {
+public:
+
+  void AddFrame( const QString& name, int width, int height, QRgb color ) {
+    QImage image( width, height, QImage::Format_RGB32 );
+    image.fill( color );
+    image.setPixel( 10, 20, qRgb( 1, 2, 3 ) );
+    ASSERT_TRUE( image.save( mDir.filePath( name ) ) );
+  }
+
+  void WriteIndex( const QByteArray& contents ) {
+    QFile file( mDir.filePath( "frames.txt" ) );
+    ASSERT_TRUE( file.open( QIODevice::WriteOnly ) );
+    file.write( contents );
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+    AddFrame( "01.png", 1920, 1080, qRgb( 255, 0, 0 ) );
+    AddFrame( "02.png", 1280, 720, qRgb( 0, 255, 0 ) );
+  }
+};
+
+TEST_F(ReplayWindowCaptureTest, PlaysDirectoryInOrder) {
+  ReplayWindowCapture capture( mDir.path() );
+  ASSERT_EQ( capture.NumFrames(), 2 );
+
+  EXPECT_TRUE( capture.WindowFound() );
+  EXPECT_EQ( capture.Width(), 1920 );
+  EXPECT_EQ( capture.Height(), 1080 );
+  EXPECT_EQ( capture.Left(), 0 );
+  EXPECT_TRUE( capture.HasFocus() );
+
+  capture.NextFrame();
+  EXPECT_EQ( capture.Width(), 1280 );
+  EXPECT_EQ( capture.Height(), 720 );
+
+  // Out of frames: the game is gone
+  capture.NextFrame();
+  EXPECT_FALSE( capture.WindowFound() );
+}
+
+TEST_F(ReplayWindowCaptureTest, UsesRecordedGeometry) {
+  WriteIndex( "# file left top focus\n02.png 100 50 0\n01.png 0 0 1\n" );
+
+  ReplayWindowCapture capture( mDir.path() );
+  ASSERT_EQ( capture.NumFrames(), 2 );
+  EXPECT_EQ( capture.Width(), 1280 );
+  EXPECT_EQ( capture.Left(), 100 );
+  EXPECT_EQ( capture.Top(), 50 );
+  EXPECT_FALSE( capture.HasFocus() );
+
+  capture.NextFrame();
+  EXPECT_EQ( capture.Width(), 1920 );
+  EXPECT_TRUE( capture.HasFocus() );
+}
+
+TEST_F(ReplayWindowCaptureTest, CapturesRegions) {
+  ReplayWindowCapture capture( mDir.path() );
+
+  QImage region = capture.CaptureImage( 10, 20, 4, 4 );
+  ASSERT_EQ( region.size(), QSize( 4, 4 ) );
+  EXPECT_EQ( region.pixel( 0, 0 ), qRgb( 1, 2, 3 ) );
+  EXPECT_EQ( region.pixel( 1, 1 ), qRgb( 255, 0, 0 ) );
+
+  // Same size: copied as is into the caller's buffer
+  QImage target( 4, 4, QImage::Format_RGB32 );
+  const uchar *bits = target.constBits();
+  EXPECT_TRUE( capture.CaptureInto( 10, 20, 4, 4, &target ) );
+  EXPECT_EQ( target.constBits(), bits );
+  EXPECT_EQ( target, region );
+
+  // Scaled down to the target
+  QImage scaled( 2, 2, QImage::Format_RGB32 );
+  EXPECT_TRUE( capture.CaptureInto( 100, 100, 40, 40, &scaled ) );
+  EXPECT_EQ( scaled.pixel( 1, 1 ), qRgb( 255, 0, 0 ) );
+}
+
+TEST_F(ReplayWindowCaptureTest, LoopsAndPacesFrames) {
+  ReplayWindowCapture capture( mDir.path() );
+  capture.SetLoop( true );
+  capture.SetFrameInterval( 20 );
+
+  EXPECT_EQ( capture.FrameIndex(), 0 );
+  QThread::msleep( 30 );
+  capture.WindowFound();
+  EXPECT_EQ( capture.FrameIndex(), 1 );
+  QThread::msleep( 30 );
+  capture.WindowFound();
+  EXPECT_EQ( capture.FrameIndex(), 0 );
+
+  capture.SetFrameInterval( 0 );
+  capture.NextFrame();
+  capture.NextFrame();
+  EXPECT_EQ( capture.FrameIndex(), 0 );
+  EXPECT_TRUE( capture.WindowFound() );
+}
@@ -0,0 +1,74 @@
+#include "ResultExporter.h"
+#include "gtest/gtest.h"
+
+#include <QFileInfo>
+
+#include "TestApplication.h"
+
+class ResultExporterTest : public TestApplication {
+public:
+  static Result TestResult( int n ) {
+    Result result;
+    result.mode = MODE_RANKED;
+    result.outcome = n % 2 ? OUTCOME_VICTORY : OUTCOME_DEFEAT;
+    result.order = ORDER_FIRST;
+    result.hero = CLASS_MAGE;
+    result.opponent = static_cast< HeroClass >( n % NUM_CLASSES );
+    result.rank = 1 + n % 25;
+    result.duration = 300;
+    result.added = QDateTime( QDate( 2026, 1, 1 ), QTime( 12, 0 ), Qt::UTC ).addSecs( n * 600 );
+    result.cardList << CardHistoryItem( 1, PLAYER_SELF, "CS2_029" );
+    result.cardList << CardHistoryItem( 1, PLAYER_OPPONENT, QString( "EX1_%1" ).arg( n ) );
+    return result;
+  }
+
+  static bool IsParquet( const QString& path ) {
+    QFile file( path );
+    if( !file.open( QIODevice::ReadOnly ) || file.size() < 12 )
+      return false;
+    QByteArray head = file.read( 4 );
+    file.seek( file.size() - 4 );
+    return head == "PAR1" && file.read( 4 ) == "PAR1";
+  }
+};
+
+TEST_F(ResultExporterTest, ExportsResultsAndCardHistory) {
+  ResultStore store( mDir.filePath( "results.store" ) );
+  for( int i = 0; i < 1000; i++ ) {
+    store.Add( TestResult( i ) );
+  }
+
+  ResultExporter exporter( &store, 128 );
+  ASSERT_TRUE( exporter.Export( mDir.path() ) );
+  EXPECT_EQ( exporter.ExportedResults(), 1000 );
+  EXPECT_EQ( exporter.ExportedCards(), 2000 );
+
+  EXPECT_TRUE( IsParquet( mDir.filePath( "results.parquet" ) ) );
+  EXPECT_TRUE( IsParquet( mDir.filePath( "card_history.parquet" ) ) );
+  EXPECT_FALSE( QFile::exists( mDir.filePath( "results.parquet.part" ) ) );
+  EXPECT_FALSE( QFile::exists( mDir.filePath( "card_history.parquet.part" ) ) );
+}
+
+TEST_F(ResultExporterTest, ReplacesPreviousExport) {
+  ResultStore store( mDir.filePath( "results.store" ) );
+  store.Add( TestResult( 0 ) );
+
+  ResultExporter exporter( &store );
+  ASSERT_TRUE( exporter.Export( mDir.path() ) );
+  qint64 size = QFileInfo( mDir.filePath( "card_history.parquet" ) ).size();
+
+  for( int i = 1; i < 100; i++ ) {
+    store.Add( TestResult( i ) );
+  }
+  ASSERT_TRUE( exporter.Export( mDir.path() ) );
+  EXPECT_EQ( exporter.ExportedResults(), 100 );
+  EXPECT_GT( QFileInfo( mDir.filePath( "card_history.parquet" ) ).size(), size );
+}
+
+TEST_F(ResultExporterTest, FailsForMissingDirectory) {
+  ResultStore store( mDir.filePath( "results.store" ) );
+  store.Add( TestResult( 0 ) );
+
+  ResultExporter exporter( &store );
+  EXPECT_FALSE( exporter.Export( mDir.filePath( "missing/dir" ) ) );
+}
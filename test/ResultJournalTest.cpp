@@ -0,0 +1,195 @@
+#include "ResultJournal.h"
+#include "gtest/gtest.h"
+
+#include <QFile>
+
+#include "TestApplication.h"
+
+#include <signal.h>
+
+class ResultJournalTest : public TestApplication {
+public:
+  QString mPath;
+
+  QJsonObject MakeResult( int n ) {
+    QJsonObject result;
+    result[ "hero" ] = "mage";
+    result[ "opponent" ] = "warrior";
+    result[ "win" ] = ( n % 2 == 0 );
+    result[ "duration" ] = n;
+    return result;
+  }
+
+  qint64 FileSize() {
+    return QFile( mPath ).size();
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+    mPath = mDir.filePath( "results.journal" );
+  }
+};
+
+TEST_F(ResultJournalTest, KeepsPendingResultsAcrossRestarts) {
+  {
+    ResultJournal journal( mPath );
+    EXPECT_TRUE( journal.Pending().isEmpty() );
+
+    quint64 first = journal.Append( MakeResult( 1 ) );
+    journal.Append( MakeResult( 2 ) );
+    journal.Append( MakeResult( 3 ) );
+    journal.Ack( first );
+  }
+
+  ResultJournal journal( mPath );
+  ASSERT_EQ( journal.Pending().size(), 2 );
+  EXPECT_EQ( journal.Pending().first(), MakeResult( 2 ) );
+  EXPECT_EQ( journal.Pending().last(), MakeResult( 3 ) );
+
+  // Ids keep increasing after a restart
+  quint64 next = journal.Append( MakeResult( 4 ) );
+  EXPECT_GT( next, journal.Pending().firstKey() );
+}
+
+TEST_F(ResultJournalTest, CompactsWhenEverythingIsAcknowledged) {
+  ResultJournal journal( mPath );
+  qint64 emptySize = FileSize();
+
+  QList< quint64 > ids;
+  for( int i = 0; i < 10; i++ ) {
+    ids << journal.Append( MakeResult( i ) );
+  }
+  EXPECT_GT( FileSize(), emptySize );
+
+  for( quint64 id : ids ) {
+    journal.Ack( id );
+  }
+  EXPECT_EQ( FileSize(), emptySize );
+  EXPECT_TRUE( journal.Pending().isEmpty() );
+
+  // Still appendable after compaction
+  journal.Append( MakeResult( 42 ) );
+  ResultJournal reopened( mPath );
+  ASSERT_EQ( reopened.Pending().size(), 1 );
+  EXPECT_EQ( reopened.Pending().first(), MakeResult( 42 ) );
+}
+
+TEST_F(ResultJournalTest, DropsTornAndCorruptRecords) {
+  {
+    ResultJournal journal( mPath );
+    journal.Append( MakeResult( 1 ) );
+    journal.Append( MakeResult( 2 ) );
+  }
+  qint64 intactSize = FileSize();
+
+  // Half written third record
+  {
+    ResultJournal journal( mPath );
+    journal.Append( MakeResult( 3 ) );
+  }
+  QFile file( mPath );
+  ASSERT_TRUE( file.resize( FileSize() - 5 ) );
+
+  {
+    ResultJournal journal( mPath );
+    EXPECT_EQ( journal.Pending().size(), 2 );
+    EXPECT_EQ( FileSize(), intactSize );
+  }
+
+  // Flip a byte in the payload of the last record
+  ASSERT_TRUE( file.open( QIODevice::ReadWrite ) );
+  file.seek( intactSize - 10 );
+  char c;
+  file.getChar( &c );
+  file.seek( intactSize - 10 );
+  file.putChar( c ^ 0x20 );
+  file.close();
+
+  ResultJournal journal( mPath );
+  ASSERT_EQ( journal.Pending().size(), 1 );
+  EXPECT_EQ( journal.Pending().first(), MakeResult( 1 ) );
+}
+
+TEST_F(ResultJournalTest, MovesUnknownVersionAside) {
+  {
+    ResultJournal journal( mPath );
+    journal.Append( MakeResult( 1 ) );
+  }
+
+  // Written by a newer version
+  QFile file( mPath );
+  ASSERT_TRUE( file.open( QIODevice::ReadWrite ) );
+  file.seek( 4 );
+  file.putChar( 2 );
+  file.close();
+  ASSERT_TRUE( file.open( QIODevice::ReadOnly ) );
+  QByteArray contents = file.readAll();
+  file.close();
+
+  {
+    ResultJournal journal( mPath );
+    EXPECT_TRUE( journal.Pending().isEmpty() );
+    journal.Append( MakeResult( 2 ) );
+  }
+
+  QFile backup( mPath + ".bak" );
+  ASSERT_TRUE( backup.open( QIODevice::ReadOnly ) );
+  EXPECT_EQ( backup.readAll(), contents );
+
+  ResultJournal journal( mPath );
+  ASSERT_EQ( journal.Pending().size(), 1 );
+  EXPECT_EQ( journal.Pending().first(), MakeResult( 2 ) );
+}
+
+TEST_F(ResultJournalTest, StartsOverOnlyWithoutResults) {
+  // Header of a new journal torn after two bytes
+  QFile file( mPath );
+  ASSERT_TRUE( file.open( QIODevice::WriteOnly ) );
+  file.write( "TO" );
+  file.close();
+
+  {
+    ResultJournal journal( mPath );
+    journal.Append( MakeResult( 1 ) );
+  }
+  EXPECT_FALSE( QFile::exists( mPath + ".bak" ) );
+
+  // Not a journal at all
+  ASSERT_TRUE( file.open( QIODevice::WriteOnly ) );
+  file.write( "something else entirely" );
+  file.close();
+
+  ResultJournal journal( mPath );
+  EXPECT_TRUE( journal.Pending().isEmpty() );
+  EXPECT_TRUE( QFile::exists( mPath + ".bak" ) );
+}
+
+TEST_F(ResultJournalTest, Checksum) {
+  EXPECT_EQ( ResultJournal::Checksum( "123456789", 9 ), 0xCBF43926u );
+}
+
+#if GTEST_HAS_DEATH_TEST && !defined( Q_OS_WIN )
+// kill -9 right after queueing: no destructor, no pending fsync
+// Needs the "fast" death test style, the child has to share mPath
+TEST_F(ResultJournalTest, SurvivesKill) {
+  EXPECT_EXIT({
+    ResultJournal journal( mPath );
+    for( int i = 0; i < 100; i++ ) {
+      quint64 id = journal.Append( MakeResult( i ) );
+      if( i % 3 == 0 )
+        journal.Ack( id );
+    }
+    raise( SIGKILL );
+  }, ::testing::KilledBySignal( SIGKILL ), "" );
+
+  ResultJournal journal( mPath );
+  ASSERT_EQ( journal.Pending().size(), 66 );
+  int i = 0;
+  for( const QJsonObject& result : journal.Pending() ) {
+    if( i % 3 == 0 )
+      i++;
+    EXPECT_EQ( result, MakeResult( i ) );
+    i++;
+  }
+}
+#endif
@@ -0,0 +1,519 @@
+#include "ResultQueue.h"
+#include "Settings.h"
+#include "Updater.h"
+#include "gtest/gtest.h"
+
+#include "FakeWebservice.h"
+#include "TestApplication.h"
+
+Updater *gUpdater = NULL;
+
+class ResultQueueTest : public TestApplication {
+public:
+  QString mJournalPath;
+  FakeWebservice *mServer;
+  int mNextId;
+
+  static QJsonObject BacklogResult( int n ) {
+    QJsonObject result;
+    result[ "hero" ] = "mage";
+    result[ "opponent" ] = "rogue";
+    result[ "mode" ] = "ranked";
+    result[ "duration" ] = n;
+    return result;
+  }
+
+  static Result LiveResult() {
+    Result result;
+    result.mode = MODE_CASUAL;
+    result.outcome = OUTCOME_VICTORY;
+    result.order = ORDER_FIRST;
+    result.hero = CLASS_MAGE;
+    result.opponent = CLASS_WARRIOR;
+    result.added = QDateTime::currentDateTime();
+    return result;
+  }
+
+  void FillBacklog( int count ) {
+    ResultJournal journal( mJournalPath );
+    for( int i = 0; i < count; i++ ) {
+      journal.Append( BacklogResult( i ) );
+    }
+  }
+
+  QList< FakeWebservice::Request > Requests( const QString& path ) {
+    QList< FakeWebservice::Request > matching;
+    for( const FakeWebservice::Request& request : mServer->requests ) {
+      if( request.path == path )
+        matching << request;
+    }
+    return matching;
+  }
+
+  // Accepts everything, except results with a duration listed in rejected
+  FakeWebservice::Response Accept( const FakeWebservice::Request& request, const QList< int >& rejected = QList< int >() ) {
+    if( request.path == "/profile/results.json" ) {
+      QJsonObject result;
+      result[ "id" ] = mNextId++;
+      QJsonObject response;
+      response[ "result" ] = result;
+      return FakeWebservice::Json( 201, response );
+    }
+
+    QJsonArray acks;
+    for( const QJsonValue& result : request.Json()[ "results" ].toArray() ) {
+      QJsonObject ack;
+      if( rejected.contains( result.toObject()[ "duration" ].toInt() ) ) {
+        ack[ "error" ] = "invalid";
+      } else {
+        ack[ "id" ] = mNextId++;
+      }
+      acks.append( ack );
+    }
+    QJsonObject response;
+    response[ "results" ] = acks;
+    return FakeWebservice::Json( 200, response );
+  }
+
+  void AcceptResults( const QList< int >& rejected = QList< int >() ) {
+    mServer->SetHandler( [this, rejected]( const FakeWebservice::Request& request ) {
+      return Accept( request, rejected );
+    });
+  }
+
+  static int FirstDuration( const FakeWebservice::Request& request ) {
+    return request.Json()[ "results" ].toArray().first().toObject()[ "duration" ].toInt();
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+    mJournalPath = mDir.filePath( "results.journal" );
+    mNextId = 1;
+
+    mServer = new FakeWebservice;
+    Settings::Instance()->SetWebserviceURL( mServer->Url() );
+    Settings::Instance()->SetAccount( "test", "secret" );
+    Settings::Instance()->SetDebugEnabled( false );
+  }
+
+  virtual void TearDown() {
+    delete mServer;
+    TestApplication::TearDown();
+  }
+};
+
+TEST_F(ResultQueueTest, DrainsBacklogInBatches) {
+  FillBacklog( 30 );
+  AcceptResults();
+
+  ResultQueue queue( mJournalPath );
+  ASSERT_EQ( queue.Size(), 30 );
+
+  QList< QPair< int, int > > progress;
+  QObject::connect( &queue, &ResultQueue::UploadProgress, [&]( int uploaded, int total ) {
+    progress << qMakePair( uploaded, total );
+  });
+
+  // Left over from the last session: goes out on its own
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  EXPECT_EQ( Requests( "/profile/results.json" ).size(), 0 );
+  QList< FakeWebservice::Request > batches = Requests( "/profile/results/bulk.json" );
+  ASSERT_EQ( batches.size(), 2 );
+  EXPECT_EQ( batches[ 0 ].Json()[ "results" ].toArray().size(), 25 );
+  EXPECT_EQ( batches[ 1 ].Json()[ "results" ].toArray().size(), 5 );
+  QJsonObject first = batches[ 0 ].Json()[ "results" ].toArray().first().toObject();
+  EXPECT_EQ( first[ "client_id" ].toString(), ResultQueue::ClientId( BacklogResult( 0 ) ) );
+  first.remove( "client_id" );
+  EXPECT_EQ( first, BacklogResult( 0 ) );
+
+  ASSERT_EQ( progress.size(), 2 );
+  EXPECT_EQ( progress.last(), qMakePair( 30, 30 ) );
+
+  EXPECT_TRUE( ResultJournal( mJournalPath ).Pending().isEmpty() );
+}
+
+TEST_F(ResultQueueTest, DeadLettersRejectedItemsOfABatch) {
+  FillBacklog( 10 );
+  AcceptResults( QList< int >() << 3 << 7 );
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+  Settle();
+
+  // Sent once, never retried
+  EXPECT_EQ( Requests( "/profile/results/bulk.json" ).size(), 1 );
+  EXPECT_EQ( queue.DeadLetterCount(), 2 );
+  EXPECT_TRUE( ResultJournal( mJournalPath ).Pending().isEmpty() );
+}
+
+TEST_F(ResultQueueTest, AcceptsBatchAcksWithoutId) {
+  FillBacklog( 3 );
+  mServer->SetHandler( []( const FakeWebservice::Request& request ) {
+    QJsonObject duplicate;
+    duplicate[ "duplicate" ] = true;
+    QJsonArray acks;
+    for( int i = 0; i < request.Json()[ "results" ].toArray().size(); i++ ) {
+      acks.append( duplicate );
+    }
+    QJsonObject response;
+    response[ "results" ] = acks;
+    return FakeWebservice::Json( 200, response );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+  Settle();
+
+  EXPECT_EQ( mServer->requests.size(), 1 );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+  EXPECT_TRUE( ResultJournal( mJournalPath ).Pending().isEmpty() );
+}
+
+TEST_F(ResultQueueTest, DeadLettersClientErrors) {
+  mServer->SetHandler( []( const FakeWebservice::Request& ) {
+    return FakeWebservice::Json( 422, QJsonObject() );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  queue.Add( LiveResult() );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.DeadLetterCount() == 1; } ) );
+  Settle();
+
+  EXPECT_EQ( queue.Size(), 0 );
+  EXPECT_EQ( mServer->requests.size(), 1 );
+}
+
+TEST_F(ResultQueueTest, SplitsRejectedBatch) {
+  FillBacklog( 10 );
+  mServer->SetHandler( [this]( const FakeWebservice::Request& request ) {
+    // One bad result spoils the whole batch, on its own it is rejected alone
+    if( request.path != "/profile/results.json" )
+      return FakeWebservice::Json( 400, QJsonObject() );
+    if( request.Json()[ "result" ].toObject()[ "duration" ].toInt() == 3 )
+      return FakeWebservice::Json( 422, QJsonObject() );
+    return Accept( request );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+  Settle();
+
+  EXPECT_EQ( Requests( "/profile/results/bulk.json" ).size(), 1 );
+  EXPECT_EQ( Requests( "/profile/results.json" ).size(), 10 );
+  EXPECT_EQ( queue.DeadLetterCount(), 1 );
+  EXPECT_TRUE( ResultJournal( mJournalPath ).Pending().isEmpty() );
+}
+
+TEST_F(ResultQueueTest, FallsBackWithoutBulkEndpoint) {
+  FillBacklog( 5 );
+  mServer->SetHandler( [this]( const FakeWebservice::Request& request ) {
+    if( request.path != "/profile/results.json" )
+      return FakeWebservice::Json( 404, QJsonObject() );
+
+    QJsonObject result;
+    result[ "id" ] = mNextId++;
+    QJsonObject response;
+    response[ "result" ] = result;
+    return FakeWebservice::Json( 201, response );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  EXPECT_EQ( Requests( "/profile/results/bulk.json" ).size(), 1 );
+  EXPECT_EQ( Requests( "/profile/results.json" ).size(), 5 );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+}
+
+TEST_F(ResultQueueTest, BacksOffWhileServerIsDown) {
+  int failures = 3;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& ) {
+    if( failures > 0 ) {
+      failures--;
+      return FakeWebservice::Json( 503, QJsonObject() );
+    }
+
+    QJsonObject result;
+    result[ "id" ] = mNextId++;
+    QJsonObject response;
+    response[ "result" ] = result;
+    return FakeWebservice::Json( 201, response );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 40, 1000 );
+  queue.Add( LiveResult() );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  // 20-40 ms, 40-80 ms, 80-160 ms
+  QList< FakeWebservice::Request >& requests = mServer->requests;
+  ASSERT_EQ( requests.size(), 4 );
+  EXPECT_GE( requests[ 1 ].time - requests[ 0 ].time, 20 );
+  EXPECT_GE( requests[ 3 ].time - requests[ 2 ].time, 80 );
+  EXPECT_GT( requests[ 3 ].time - requests[ 2 ].time, requests[ 1 ].time - requests[ 0 ].time );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+}
+
+TEST_F(ResultQueueTest, HonorsRetryAfter) {
+  int failures = 1;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& ) {
+    if( failures > 0 ) {
+      failures--;
+      FakeWebservice::Response response = FakeWebservice::Json( 429, QJsonObject() );
+      response.headers << qMakePair( QByteArray( "Retry-After" ), QByteArray( "1" ) );
+      return response;
+    }
+
+    QJsonObject result;
+    result[ "id" ] = mNextId++;
+    QJsonObject response;
+    response[ "result" ] = result;
+    return FakeWebservice::Json( 201, response );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 5000 );
+  queue.Add( LiveResult() );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  ASSERT_EQ( mServer->requests.size(), 2 );
+  EXPECT_GE( mServer->requests[ 1 ].time - mServer->requests[ 0 ].time, 950 );
+}
+
+TEST_F(ResultQueueTest, RecordsUploadStats) {
+  int failures = 1;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& request ) {
+    if( failures > 0 ) {
+      failures--;
+      return FakeWebservice::Json( 503, QJsonObject() );
+    }
+    return Accept( request );
+  });
+
+  UploadStats *stats = UploadStats::Instance();
+  stats->Reset();
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  queue.Add( LiveResult() );
+  EXPECT_EQ( stats->Queued(), 1 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  EXPECT_EQ( stats->Requests(), 2 );
+  EXPECT_EQ( stats->StatusCodes().value( 503 ), 1 );
+  EXPECT_EQ( stats->StatusCodes().value( 201 ), 1 );
+  EXPECT_GT( stats->BytesSent(), 0 );
+  EXPECT_EQ( stats->RequestLatency().Count(), 2 );
+  EXPECT_EQ( stats->Retries(), 1 );
+  EXPECT_EQ( stats->Uploaded(), 1 );
+  EXPECT_EQ( stats->Backlog(), 0 );
+  ASSERT_EQ( stats->AckLatency().Count(), 1 );
+  EXPECT_GE( stats->AckLatency().Max(), stats->RequestLatency().Max() );
+}
+
+TEST_F(ResultQueueTest, RetriesUnreadableReply) {
+  int garbage = 1;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& request ) {
+    if( garbage > 0 ) {
+      garbage--;
+      FakeWebservice::Response response = { 200, "garbage", {} };
+      return response;
+    }
+    return Accept( request );
+  });
+
+  // With a window of one a lost reply would stall the queue for good
+  ResultQueue queue( mJournalPath );
+  queue.SetMaxInFlight( 1 );
+  queue.SetBackoff( 10, 100 );
+  queue.Add( LiveResult() );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  ASSERT_EQ( mServer->requests.size(), 2 );
+  EXPECT_EQ( mServer->requests[ 0 ].body, mServer->requests[ 1 ].body );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+}
+
+TEST_F(ResultQueueTest, ResultIdIsStable) {
+  Result result = LiveResult();
+  result.cardList << CardHistoryItem( 1, PLAYER_SELF, "CS2_029" );
+  Result copy = result;
+  EXPECT_EQ( result.Id(), copy.Id() );
+  EXPECT_EQ( result.AsJson()[ "client_id" ].toString(), result.Id() );
+
+  copy.cardList << CardHistoryItem( 2, PLAYER_OPPONENT, "CS2_106" );
+  EXPECT_NE( result.Id(), copy.Id() );
+
+  copy = result;
+  copy.added = copy.added.addSecs( 1 );
+  EXPECT_NE( result.Id(), copy.Id() );
+}
+
+TEST_F(ResultQueueTest, SendsIdempotencyKey) {
+  AcceptResults();
+
+  Result result = LiveResult();
+  ResultQueue queue( mJournalPath );
+  queue.Add( result );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  ASSERT_EQ( mServer->requests.size(), 1 );
+  EXPECT_TRUE( mServer->requests[ 0 ].headers.contains( "Idempotency-Key: " + result.Id().toLatin1() ) );
+  EXPECT_EQ( mServer->requests[ 0 ].Json()[ "result" ].toObject()[ "client_id" ].toString(), result.Id() );
+}
+
+TEST_F(ResultQueueTest, DropsDuplicates) {
+  AcceptResults();
+
+  Result result = LiveResult();
+  ResultQueue queue( mJournalPath );
+  queue.Add( result );
+  queue.Add( result );
+  EXPECT_EQ( queue.Size(), 1 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+
+  // Also once it is uploaded
+  queue.Add( result );
+  EXPECT_EQ( queue.Size(), 0 );
+  Settle();
+  EXPECT_EQ( mServer->requests.size(), 1 );
+}
+
+TEST_F(ResultQueueTest, DropsDuplicatesInBacklog) {
+  FillBacklog( 3 );
+  {
+    ResultJournal journal( mJournalPath );
+    journal.Append( BacklogResult( 1 ) );
+  }
+
+  ResultQueue queue( mJournalPath );
+  EXPECT_EQ( queue.Size(), 3 );
+  EXPECT_EQ( ResultJournal( mJournalPath ).Pending().size(), 3 );
+}
+
+TEST_F(ResultQueueTest, ConflictMeansUploaded) {
+  mServer->SetHandler( []( const FakeWebservice::Request& ) {
+    return FakeWebservice::Json( 409, QJsonObject() );
+  });
+
+  ResultQueue queue( mJournalPath );
+  queue.SetBackoff( 10, 100 );
+  queue.Add( LiveResult() );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+  Settle();
+
+  EXPECT_EQ( mServer->requests.size(), 1 );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+  EXPECT_TRUE( ResultJournal( mJournalPath ).Pending().isEmpty() );
+}
+
+TEST_F(ResultQueueTest, LimitsRequestsInFlight) {
+  FillBacklog( 60 );
+  AcceptResults();
+  mServer->Hold();
+
+  ResultQueue queue( mJournalPath );
+  queue.SetMaxInFlight( 2 );
+  queue.SetBackoff( 10, 100 );
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->NumHeld() == 2; } ) );
+  Settle();
+  EXPECT_EQ( mServer->NumHeld(), 2 );
+
+  // A reply frees a slot for the last batch
+  mServer->Release( 1 );
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->requests.size() == 3; } ) );
+
+  mServer->Release( 2 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+  EXPECT_EQ( Requests( "/profile/results/bulk.json" ).size(), 3 );
+}
+
+TEST_F(ResultQueueTest, RejectedBatchWaitsForRetryOfOlderRequest) {
+  FillBacklog( 30 );
+  bool failed = false;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& request ) {
+    if( request.path == "/profile/results/bulk.json" ) {
+      if( FirstDuration( request ) == 25 )
+        return FakeWebservice::Json( 400, QJsonObject() );
+      if( !failed ) {
+        failed = true;
+        return FakeWebservice::Json( 503, QJsonObject() );
+      }
+    }
+    return Accept( request );
+  });
+  mServer->Hold();
+
+  ResultQueue queue( mJournalPath );
+  queue.SetMaxInFlight( 2 );
+  queue.SetBackoff( 2000, 4000 );
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->NumHeld() == 2; } ) );
+
+  // Oldest batch fails with a retry, then the other one is rejected as a whole
+  int oldest = FirstDuration( mServer->Held( 0 ) ) == 0 ? 0 : 1;
+  mServer->ReleaseAt( oldest );
+  Settle();
+  mServer->ReleaseAt( 0 );
+  Settle();
+
+  // Its results do not go out one by one ahead of the retry
+  EXPECT_EQ( mServer->requests.size(), 2 );
+
+  // Then the retry, alongside the first of them
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->requests.size() == 4; } ) );
+  QList< FakeWebservice::Request > batches = Requests( "/profile/results/bulk.json" );
+  ASSERT_EQ( batches.size(), 3 );
+  EXPECT_EQ( FirstDuration( batches[ 2 ] ), 0 );
+
+  ASSERT_TRUE( WaitFor( [&]() {
+    mServer->Release( mServer->NumHeld() );
+    return queue.Size() == 0;
+  }));
+  EXPECT_EQ( Requests( "/profile/results.json" ).size(), 5 );
+  EXPECT_EQ( queue.DeadLetterCount(), 0 );
+}
+
+TEST_F(ResultQueueTest, RetriesFailedRequestBeforeNewerResults) {
+  FillBacklog( 60 );
+  bool failed = false;
+  mServer->SetHandler( [&]( const FakeWebservice::Request& request ) {
+    if( !failed && FirstDuration( request ) == 0 ) {
+      failed = true;
+      return FakeWebservice::Json( 503, QJsonObject() );
+    }
+    return Accept( request );
+  });
+  mServer->Hold();
+
+  ResultQueue queue( mJournalPath );
+  queue.SetMaxInFlight( 2 );
+  queue.SetBackoff( 2000, 4000 );
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->NumHeld() == 2; } ) );
+
+  // Oldest batch fails, the one sent along with it goes through
+  int oldest = FirstDuration( mServer->Held( 0 ) ) == 0 ? 0 : 1;
+  mServer->ReleaseAt( oldest );
+  Settle();
+  mServer->ReleaseAt( 0 );
+  Settle();
+
+  // Nothing newer goes out until the failed batch is retried
+  EXPECT_EQ( mServer->requests.size(), 2 );
+  EXPECT_EQ( queue.Size(), 35 );
+
+  ASSERT_TRUE( WaitFor( [&]() { return mServer->requests.size() == 4; } ) );
+  QList< int > retried;
+  retried << FirstDuration( mServer->requests[ 2 ] ) << FirstDuration( mServer->requests[ 3 ] );
+  EXPECT_TRUE( retried.contains( 0 ) );
+  EXPECT_TRUE( retried.contains( 50 ) );
+
+  mServer->Release( 2 );
+  ASSERT_TRUE( WaitFor( [&]() { return queue.Size() == 0; } ) );
+}
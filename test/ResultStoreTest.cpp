@@ -0,0 +1,264 @@
+#include "ResultStore.h"
+#include "gtest/gtest.h"
+
+#include <QElapsedTimer>
+
+#include <random>
+
+#include "TestApplication.h"
+
+class ResultStoreTest : public TestApplication {
+public:
+  QString mPath;
+  std::mt19937 mRandom;
+  QDateTime mStart;
+
+  Result RandomResult( int n ) {
+    static const GameMode modes[] = { MODE_RANKED, MODE_CASUAL, MODE_ARENA, MODE_FRIENDLY };
+
+    Result result;
+    result.mode = modes[ mRandom() % 4 ];
+    result.outcome = static_cast< Outcome >( mRandom() % 2 );
+    result.order = static_cast< GoingOrder >( mRandom() % 2 );
+    result.hero = static_cast< HeroClass >( mRandom() % NUM_CLASSES );
+    result.opponent = static_cast< HeroClass >( mRandom() % NUM_CLASSES );
+    if( result.mode == MODE_RANKED ) {
+      if( mRandom() % 10 == 0 ) {
+        result.legend = 1 + mRandom() % 5000;
+      } else {
+        result.rank = mRandom() % 26; // incl. RANK_UNKNOWN
+      }
+    }
+    result.duration = 300 + mRandom() % 600;
+    result.added = mStart.addSecs( n * 600 );
+    result.cardList << CardHistoryItem( 1, PLAYER_SELF, "CS2_029" );
+    result.cardList << CardHistoryItem( 2, PLAYER_OPPONENT, QString( "EX1_%1" ).arg( n ) );
+    return result;
+  }
+
+  // Straightforward count the store is checked against
+  static bool Matches( const Result& result, const ResultFilter& filter ) {
+    int rank = result.mode == MODE_RANKED && result.legend == LEGEND_UNKNOWN ? result.rank : RANK_UNKNOWN;
+    return ( filter.mode == MODE_UNKNOWN || result.mode == filter.mode ) &&
+      ( filter.hero == CLASS_UNKNOWN || result.hero == filter.hero ) &&
+      ( filter.opponent == CLASS_UNKNOWN || result.opponent == filter.opponent ) &&
+      ( filter.order == ORDER_UNKNOWN || result.order == filter.order ) &&
+      ( ( !filter.minRank && !filter.maxRank ) ||
+        ( rank != RANK_UNKNOWN && ( !filter.minRank || rank >= filter.minRank ) && ( !filter.maxRank || rank <= filter.maxRank ) ) ) &&
+      ( !filter.from.isValid() || result.added >= filter.from ) &&
+      ( !filter.to.isValid() || result.added <= filter.to );
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+    mPath = mDir.filePath( "results.store" );
+    mRandom.seed( 1337 );
+    mStart = QDateTime( QDate( 2026, 1, 1 ), QTime( 12, 0 ), Qt::UTC );
+  }
+};
+
+TEST_F(ResultStoreTest, KeepsResultsAcrossRestarts) {
+  Result result = RandomResult( 0 );
+  {
+    ResultStore store( mPath );
+    store.Add( result );
+    store.Add( RandomResult( 1 ) );
+    EXPECT_EQ( store.Size(), 2 );
+  }
+
+  ResultStore store( mPath );
+  ASSERT_EQ( store.Size(), 2 );
+  EXPECT_EQ( store.Results()[ 0 ].added, result.added.toMSecsSinceEpoch() );
+  EXPECT_EQ( store.Results()[ 0 ].hero, result.hero );
+  EXPECT_EQ( store.Results()[ 0 ].opponent, result.opponent );
+  EXPECT_EQ( store.Details( 0 ), result.AsJson() );
+  EXPECT_EQ( store.Details( 1 )[ "card_history" ].toArray().size(), 2 );
+}
+
+TEST_F(ResultStoreTest, IgnoresDuplicates) {
+  ResultStore store( mPath );
+  Result result = RandomResult( 0 );
+  store.Add( result );
+  store.Add( result );
+  EXPECT_EQ( store.Size(), 1 );
+}
+
+TEST_F(ResultStoreTest, DropsTornTail) {
+  {
+    ResultStore store( mPath );
+    store.Add( RandomResult( 0 ) );
+    store.Add( RandomResult( 1 ) );
+  }
+
+  QFile file( mPath );
+  ASSERT_TRUE( file.open( QIODevice::ReadWrite ) );
+  file.resize( file.size() - 10 );
+  file.close();
+
+  ResultStore store( mPath );
+  EXPECT_EQ( store.Size(), 1 );
+
+  // Appending goes on after the last intact record
+  Result result = RandomResult( 2 );
+  store.Add( result );
+  ResultStore reopened( mPath );
+  EXPECT_EQ( reopened.Size(), 2 );
+  EXPECT_EQ( reopened.Details( 1 ), result.AsJson() );
+}
+
+TEST_F(ResultStoreTest, ReadOnlyNeverWrites) {
+  ResultStore writer( mPath );
+  writer.Add( RandomResult( 0 ) );
+  writer.Add( RandomResult( 1 ) );
+
+  // Catch the writer in the middle of an append
+  QFile file( mPath );
+  ASSERT_TRUE( file.open( QIODevice::ReadWrite ) );
+  qint64 size = file.size() - 10;
+  file.resize( size );
+  file.close();
+
+  {
+    ResultStore reader( mPath, ResultStore::READ_ONLY );
+    EXPECT_TRUE( reader.IsOpen() );
+    EXPECT_EQ( reader.Size(), 1 );
+    reader.Add( RandomResult( 2 ) );
+    EXPECT_EQ( reader.Size(), 1 );
+  }
+
+  ASSERT_TRUE( file.open( QIODevice::ReadOnly ) );
+  EXPECT_EQ( file.size(), size );
+  file.close();
+
+  // A wrong path does not create a new store
+  ResultStore missing( mDir.filePath( "missing/results.store" ), ResultStore::READ_ONLY );
+  EXPECT_FALSE( missing.IsOpen() );
+  EXPECT_FALSE( QFile::exists( mDir.filePath( "missing" ) ) );
+}
+
+TEST_F(ResultStoreTest, LeavesUnknownFilesAlone) {
+  QFile file( mPath );
+  ASSERT_TRUE( file.open( QIODevice::WriteOnly ) );
+  file.write( "something else entirely" );
+  file.close();
+
+  {
+    ResultStore store( mPath );
+    store.Add( RandomResult( 0 ) );
+    EXPECT_EQ( store.Size(), 0 );
+  }
+
+  ASSERT_TRUE( file.open( QIODevice::ReadOnly ) );
+  EXPECT_EQ( file.readAll(), QByteArray( "something else entirely" ) );
+}
+
+TEST_F(ResultStoreTest, QueriesMatchReference) {
+  QList< Result > results;
+  ResultStore store( mPath );
+  for( int n = 0; n < 2000; n++ ) {
+    results << RandomResult( n );
+    store.Add( results.last() );
+  }
+
+  QList< ResultFilter > filters;
+  filters << ResultFilter();
+
+  ResultFilter filter;
+  filter.mode = MODE_RANKED;
+  filters << filter;
+  filter.hero = CLASS_MAGE;
+  filters << filter;
+  filter.opponent = CLASS_WARRIOR;
+  filter.order = ORDER_SECOND;
+  filters << filter;
+
+  filter = ResultFilter();
+  filter.minRank = 6;
+  filter.maxRank = 10;
+  filters << filter;
+  filter.minRank = filter.maxRank = 3;
+  filters << filter;
+
+  filter = ResultFilter();
+  filter.from = mStart.addDays( 2 );
+  filter.to = mStart.addDays( 5 );
+  filters << filter;
+  filter.opponent = CLASS_PRIEST;
+  filters << filter;
+
+  for( const ResultFilter& f : filters ) {
+    WinLoss expected = { 0, 0 };
+    WinLoss expectedMatchup = { 0, 0 };
+    WinLoss expectedFirst = { 0, 0 };
+    QMap< int, int > expectedBands;
+    for( const Result& result : results ) {
+      if( !Matches( result, f ) )
+        continue;
+
+      expected.games++;
+      expected.wins += result.outcome == OUTCOME_VICTORY;
+      if( result.hero == CLASS_DRUID && result.opponent == CLASS_HUNTER ) {
+        expectedMatchup.games++;
+        expectedMatchup.wins += result.outcome == OUTCOME_VICTORY;
+      }
+      if( result.order == ORDER_FIRST ) {
+        expectedFirst.games++;
+        expectedFirst.wins += result.outcome == OUTCOME_VICTORY;
+      }
+      if( result.mode == MODE_RANKED && result.legend != LEGEND_UNKNOWN ) {
+        expectedBands[ 0 ]++;
+      } else if( result.mode == MODE_RANKED && result.rank != RANK_UNKNOWN ) {
+        expectedBands[ ( result.rank - 1 ) / 5 * 5 + 1 ]++;
+      }
+    }
+
+    EXPECT_EQ( store.Count( f ), expected.games );
+    WinLoss total = store.Total( f );
+    EXPECT_EQ( total.games, expected.games );
+    EXPECT_EQ( total.wins, expected.wins );
+
+    WinLoss matchup = store.ByMatchup( f )[ CLASS_DRUID * NUM_CLASSES + CLASS_HUNTER ];
+    EXPECT_EQ( matchup.games, expectedMatchup.games );
+    EXPECT_EQ( matchup.wins, expectedMatchup.wins );
+
+    WinLoss first = store.ByOrder( f )[ ORDER_FIRST ];
+    EXPECT_EQ( first.games, expectedFirst.games );
+    EXPECT_EQ( first.wins, expectedFirst.wins );
+
+    QMap< int, WinLoss > bands = store.ByRankBand( f );
+    EXPECT_EQ( bands.keys(), expectedBands.keys() );
+    for( int band : expectedBands.keys() ) {
+      EXPECT_EQ( bands[ band ].games, expectedBands[ band ] );
+    }
+  }
+}
+
+TEST_F(ResultStoreTest, Throughput) {
+  const int count = 50000;
+  {
+    ResultStore store( mPath );
+    for( int n = 0; n < count; n++ ) {
+      store.Add( RandomResult( n ) );
+    }
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  ResultStore store( mPath );
+  qint64 loadTime = timer.elapsed();
+  ASSERT_EQ( store.Size(), count );
+
+  ResultFilter ranked;
+  ranked.mode = MODE_RANKED;
+
+  timer.restart();
+  store.ByMatchup( ResultFilter() );
+  store.ByOrder( ranked );
+  store.ByRankBand( ranked );
+  ranked.hero = CLASS_MAGE;
+  store.Total( ranked );
+  double queryTime = timer.nsecsElapsed() / 1e6;
+
+  printf( "ResultStore: %d results loaded in %lld ms, 4 queries in %.2f ms\n", count, loadTime, queryTime );
+  EXPECT_LT( queryTime, 100.0 );
+}
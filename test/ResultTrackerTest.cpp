@@ -0,0 +1,78 @@
+#include "ResultTracker.h"
+#include "Settings.h"
+#include "gtest/gtest.h"
+
+#include <QThread>
+
+#include "FakeWebservice.h"
+#include "TestApplication.h"
+
+class ResultTrackerTest : public TestApplication {
+public:
+  FakeWebservice *mServer;
+
+  // What the log tracker reports for one game
+  static void PlayGame( ResultTracker *tracker ) {
+    CardHistoryList cards;
+    cards << CardHistoryItem( 1, PLAYER_SELF, "CS2_029" );
+    cards << CardHistoryItem( 2, PLAYER_OPPONENT, "EX1_277" );
+
+    tracker->HandleGameMode( MODE_CASUAL );
+    tracker->HandleOwnClass( CLASS_MAGE );
+    tracker->HandleOpponentClass( CLASS_WARRIOR );
+    tracker->HandleOrder( ORDER_FIRST );
+    tracker->HandleCardsPlayedUpdate( cards );
+    tracker->HandleOutcome( OUTCOME_VICTORY );
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+
+    mServer = new FakeWebservice;
+    mServer->SetHandler( []( const FakeWebservice::Request& ) {
+      QJsonObject result;
+      result[ "id" ] = 1;
+      QJsonObject response;
+      response[ "result" ] = result;
+      return FakeWebservice::Json( 201, response );
+    });
+    Settings::Instance()->SetWebserviceURL( mServer->Url() );
+    Settings::Instance()->SetAccount( "test", "secret" );
+    Settings::Instance()->SetDebugEnabled( false );
+  }
+
+  virtual void TearDown() {
+    delete mServer;
+    TestApplication::TearDown();
+  }
+};
+
+TEST_F(ResultTrackerTest, RepeatedMatchEndIsQueuedOnce) {
+  ResultTracker tracker;
+  QList< Result > recorded;
+  QObject::connect( &tracker, &ResultTracker::ResultRecorded, [&recorded]( const Result& result ) {
+    recorded << result;
+  });
+
+  tracker.HandleMatchStart();
+  PlayGame( &tracker );
+  tracker.HandleMatchEnd();
+  ASSERT_TRUE( WaitFor( [this]() { return mServer->requests.size() == 1; } ) );
+
+  // Same game reported again, a bit later
+  QThread::msleep( 20 );
+  PlayGame( &tracker );
+  tracker.HandleMatchEnd();
+
+  ASSERT_EQ( recorded.size(), 1 );
+  EXPECT_EQ( recorded.first().added.time().msec(), 0 );
+  Settle();
+  EXPECT_EQ( mServer->requests.size(), 1 );
+
+  // A new match (starting in another second) is a new result
+  QThread::msleep( 1000 - QTime::currentTime().msec() );
+  tracker.HandleMatchStart();
+  PlayGame( &tracker );
+  tracker.HandleMatchEnd();
+  EXPECT_EQ( recorded.size(), 2 );
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#include <functional>
+
+#define TEST_APPLICATION_TIMEOUT 5000
+
+// Base fixture: an application and a temporary directory per test
+//
+// Settings are kept in an ini file inside that directory and the
+// standard paths point to their test locations, so tests never
+// read or change the settings and results of the user running them
+class TestApplication : public ::testing::Test {
+public:
+  QCoreApplication *mApp;
+  QTemporaryDir mDir;
+
+  TestApplication()
+    : mApp( NULL )
+  {
+  }
+
+  // Run the event loop until the condition holds
+  bool WaitFor( std::function< bool() > condition, int timeout = TEST_APPLICATION_TIMEOUT ) {
+    QElapsedTimer timer;
+    timer.start();
+    while( !condition() && timer.elapsed() < timeout ) {
+      QCoreApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+    return condition();
+  }
+
+  // Run the event loop for a bit, to see nothing else happens
+  void Settle() {
+    QElapsedTimer timer;
+    timer.start();
+    while( timer.elapsed() < 200 ) {
+      QCoreApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+  }
+
+  virtual void SetUp() {
+    QStandardPaths::setTestModeEnabled( true );
+    QSettings::setDefaultFormat( QSettings::IniFormat );
+    QSettings::setPath( QSettings::IniFormat, QSettings::UserScope, mDir.filePath( "settings" ) );
+
+    int argc = 0;
+    mApp = new QCoreApplication( argc, NULL );
+    mApp->setOrganizationName( "spidy.ch" );
+    mApp->setApplicationName( "Track-o-Bot-Test" );
+
+    // Journals of a previous run
+    QDir( QStandardPaths::writableLocation( QStandardPaths::DataLocation ) ).removeRecursively();
+
+    ASSERT_TRUE( mDir.isValid() );
+  }
+
+  virtual void TearDown() {
+    QDir( QStandardPaths::writableLocation( QStandardPaths::DataLocation ) ).removeRecursively();
+    delete mApp;
+  }
+};
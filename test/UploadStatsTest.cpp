@@ -0,0 +1,86 @@
+#include "UploadStats.h"
+#include "gtest/gtest.h"
+
+#include <QJsonArray>
+
+TEST(HistogramTest, CountsIntoBuckets) {
+  Histogram histogram( QVector< qint64 >() << 10 << 100 << 1000 );
+  for( qint64 value : { 5, 10, 11, 50, 100, 999, 5000 } ) {
+    histogram.Add( value );
+  }
+
+  EXPECT_EQ( histogram.Count(), 7 );
+  EXPECT_EQ( histogram.Max(), 5000 );
+  EXPECT_EQ( histogram.Mean(), ( 5 + 10 + 11 + 50 + 100 + 999 + 5000 ) / 7 );
+
+  QJsonArray buckets = histogram.AsJson()[ "buckets" ].toArray();
+  ASSERT_EQ( buckets.size(), 4 );
+  EXPECT_EQ( buckets[ 0 ].toObject()[ "le" ].toInt(), 10 );
+  EXPECT_EQ( buckets[ 0 ].toObject()[ "count" ].toInt(), 2 );
+  EXPECT_EQ( buckets[ 1 ].toObject()[ "count" ].toInt(), 3 );
+  EXPECT_EQ( buckets[ 2 ].toObject()[ "count" ].toInt(), 1 );
+  EXPECT_FALSE( buckets[ 3 ].toObject().contains( "le" ) );
+  EXPECT_EQ( buckets[ 3 ].toObject()[ "count" ].toInt(), 1 );
+}
+
+TEST(HistogramTest, Percentiles) {
+  Histogram histogram( QVector< qint64 >() << 100 << 1000 << 10000 );
+  EXPECT_EQ( histogram.Percentile( 50 ), 0 );
+
+  for( int i = 0; i < 90; i++ ) {
+    histogram.Add( 50 );
+  }
+  for( int i = 0; i < 9; i++ ) {
+    histogram.Add( 800 );
+  }
+  histogram.Add( 20000 );
+
+  EXPECT_EQ( histogram.Percentile( 50 ), 100 );
+  EXPECT_EQ( histogram.Percentile( 90 ), 100 );
+  EXPECT_EQ( histogram.Percentile( 95 ), 1000 );
+  EXPECT_EQ( histogram.Percentile( 100 ), 20000 );
+
+  histogram.Clear();
+  histogram.Add( 30 );
+  EXPECT_EQ( histogram.Percentile( 50 ), 30 );
+}
+
+TEST(UploadStatsTest, Snapshot) {
+  UploadStats *stats = UploadStats::Instance();
+  stats->Reset();
+
+  stats->RecordQueued( 1 );
+  stats->RecordRequest( 503, 300, 900, 120 );
+  stats->RecordRetry();
+  stats->RecordRequest( 201, 300, 900, 80 );
+  stats->RecordUploaded( 5000, 0 );
+  stats->RecordUploaded( -1, 0 );
+  stats->RecordDuplicate();
+
+  QJsonObject snapshot = stats->Snapshot();
+  EXPECT_EQ( snapshot[ "version" ].toInt(), 1 );
+
+  QJsonObject requests = snapshot[ "requests" ].toObject();
+  EXPECT_EQ( requests[ "count" ].toInt(), 2 );
+  EXPECT_EQ( requests[ "bytes_sent" ].toInt(), 600 );
+  EXPECT_EQ( requests[ "json_bytes" ].toInt(), 1800 );
+  EXPECT_EQ( requests[ "status" ].toObject()[ "503" ].toInt(), 1 );
+  EXPECT_EQ( requests[ "status" ].toObject()[ "201" ].toInt(), 1 );
+  EXPECT_EQ( requests[ "latency_ms" ].toObject()[ "max" ].toInt(), 120 );
+
+  QJsonObject results = snapshot[ "results" ].toObject();
+  EXPECT_EQ( results[ "queued" ].toInt(), 1 );
+  EXPECT_EQ( results[ "uploaded" ].toInt(), 2 );
+  EXPECT_EQ( results[ "retries" ].toInt(), 1 );
+  EXPECT_EQ( results[ "duplicates" ].toInt(), 1 );
+  EXPECT_EQ( results[ "backlog" ].toInt(), 0 );
+  EXPECT_EQ( results[ "max_backlog" ].toInt(), 1 );
+
+  // Results from an earlier session have no enqueue time
+  EXPECT_EQ( results[ "ack_latency_ms" ].toObject()[ "count" ].toInt(), 1 );
+  EXPECT_EQ( results[ "ack_latency_ms" ].toObject()[ "max" ].toInt(), 5000 );
+
+  stats->Reset();
+  EXPECT_EQ( stats->Requests(), 0 );
+  EXPECT_EQ( stats->AckLatency().Count(), 0 );
+}
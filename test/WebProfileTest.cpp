@@ -0,0 +1,203 @@
+#include "WebProfile.h"
+#include "ResultJournal.h"
+#include "Settings.h"
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include "FakeWebservice.h"
+#include "TestApplication.h"
+
+#define WEB_PROFILE_TEST_TIMEOUT 5000
+
+class WebProfileTest : public TestApplication {
+public:
+  FakeWebservice *mServer;
+  WebProfile *mWebProfile;
+  int mUploaded;
+
+  static QJsonObject TestResult() {
+    QJsonObject play;
+    play[ "turn" ] = 1;
+    play[ "player" ] = "me";
+    play[ "card_id" ] = "CS2_029";
+
+    QJsonArray cardHistory;
+    for( int i = 0; i < 20; i++ ) {
+      cardHistory.append( play );
+    }
+
+    QJsonObject result;
+    result[ "hero" ] = "mage";
+    result[ "opponent" ] = "rogue";
+    result[ "card_history" ] = cardHistory;
+    return result;
+  }
+
+  // Inverse of WebProfile::Gzip for the payloads checked here,
+  // expected is needed to rebuild the zlib trailer for qUncompress
+  static bool GunzipsTo( const QByteArray& gzip, const QByteArray& expected ) {
+    if( gzip.size() < 18 || quint8( gzip[ 0 ] ) != 0x1f || quint8( gzip[ 1 ] ) != 0x8b || gzip[ 2 ] != 8 )
+      return false;
+
+    const uchar *trailer = reinterpret_cast< const uchar* >( gzip.constData() ) + gzip.size() - 8;
+    if( qFromLittleEndian< quint32 >( trailer ) != ResultJournal::Checksum( expected.constData(), expected.size() ) ||
+        qFromLittleEndian< quint32 >( trailer + 4 ) != quint32( expected.size() ) )
+      return false;
+
+    quint32 a = 1, b = 0;
+    for( char c : expected ) {
+      a = ( a + quint8( c ) ) % 65521;
+      b = ( b + a ) % 65521;
+    }
+
+    QByteArray zlib( 6, 0 );
+    qToBigEndian< quint32 >( expected.size(), reinterpret_cast< uchar* >( zlib.data() ) );
+    zlib[ 4 ] = 0x78;
+    zlib[ 5 ] = char( 0x9c );
+    zlib += gzip.mid( 10, gzip.size() - 18 );
+    QByteArray adler( 4, 0 );
+    qToBigEndian< quint32 >( ( b << 16 ) | a, reinterpret_cast< uchar* >( adler.data() ) );
+    zlib += adler;
+
+    return qUncompress( zlib ) == expected;
+  }
+
+  static QByteArray ExpectedPayload() {
+    QJsonObject params;
+    params[ "result" ] = TestResult();
+    return QJsonDocument( params ).toJson( QJsonDocument::Compact );
+  }
+
+  static bool Gzipped( const FakeWebservice::Request& request ) {
+    return request.headers.toLower().contains( "content-encoding: gzip" );
+  }
+
+  bool WaitForUploads( int count ) {
+    QElapsedTimer timer;
+    timer.start();
+    while( mUploaded < count && timer.elapsed() < WEB_PROFILE_TEST_TIMEOUT ) {
+      QCoreApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+    return mUploaded == count;
+  }
+
+  // Accepts results, advertising gzip support unless told otherwise
+  void AcceptResults( bool advertiseGzip, bool rejectGzip = false ) {
+    mServer->SetHandler( [=]( const FakeWebservice::Request& request ) {
+      if( rejectGzip && Gzipped( request ) ) {
+        return FakeWebservice::Json( 415, QJsonObject() );
+      }
+
+      QJsonObject result;
+      result[ "id" ] = 1;
+      QJsonObject response;
+      response[ "result" ] = result;
+      FakeWebservice::Response reply = FakeWebservice::Json( 201, response );
+      if( advertiseGzip ) {
+        reply.headers << qMakePair( QByteArray( "Accept-Encoding" ), QByteArray( "gzip" ) );
+      }
+      return reply;
+    });
+  }
+
+  virtual void SetUp() {
+    TestApplication::SetUp();
+
+    mServer = new FakeWebservice;
+    Settings::Instance()->SetWebserviceURL( mServer->Url() );
+    Settings::Instance()->SetAccount( "test", "secret" );
+    Settings::Instance()->SetDebugEnabled( false );
+
+    mUploaded = 0;
+    mWebProfile = new WebProfile;
+    QObject::connect( mWebProfile, &WebProfile::UploadResultSucceeded, [this]() { mUploaded++; } );
+  }
+
+  virtual void TearDown() {
+    delete mWebProfile;
+    delete mServer;
+    TestApplication::TearDown();
+  }
+};
+
+TEST_F(WebProfileTest, Gzip) {
+  QByteArray payload = ExpectedPayload();
+  QByteArray gzip = WebProfile::Gzip( payload );
+
+  EXPECT_TRUE( GunzipsTo( gzip, payload ) );
+  EXPECT_LT( gzip.size() * 3, payload.size() );
+  EXPECT_TRUE( GunzipsTo( WebProfile::Gzip( QByteArray() ), QByteArray() ) );
+}
+
+TEST_F(WebProfileTest, SendsCompactJsonUntilServerAcceptsGzip) {
+  AcceptResults( true );
+
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 1 ) );
+  EXPECT_TRUE( mWebProfile->GzipSupported() );
+
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 2 ) );
+
+  ASSERT_EQ( mServer->requests.size(), 2 );
+  EXPECT_FALSE( Gzipped( mServer->requests[ 0 ] ) );
+  EXPECT_EQ( mServer->requests[ 0 ].body, ExpectedPayload() );
+  EXPECT_TRUE( Gzipped( mServer->requests[ 1 ] ) );
+  EXPECT_TRUE( GunzipsTo( mServer->requests[ 1 ].body, ExpectedPayload() ) );
+}
+
+TEST_F(WebProfileTest, StaysUncompressedWithoutCapability) {
+  AcceptResults( false );
+
+  mWebProfile->UploadResult( TestResult() );
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 2 ) );
+
+  EXPECT_FALSE( mWebProfile->GzipSupported() );
+  for( const FakeWebservice::Request& request : mServer->requests ) {
+    EXPECT_FALSE( Gzipped( request ) );
+  }
+}
+
+TEST_F(WebProfileTest, ResendsUncompressedOn415) {
+  AcceptResults( true );
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 1 ) );
+
+  // Server forgot about gzip in the meantime
+  AcceptResults( false, true );
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 2 ) );
+
+  ASSERT_EQ( mServer->requests.size(), 3 );
+  EXPECT_TRUE( Gzipped( mServer->requests[ 1 ] ) );
+  EXPECT_FALSE( Gzipped( mServer->requests[ 2 ] ) );
+  EXPECT_EQ( mServer->requests[ 2 ].body, ExpectedPayload() );
+  EXPECT_FALSE( mWebProfile->GzipSupported() );
+}
+
+TEST_F(WebProfileTest, UploadUsesPrewarmedConnection) {
+  AcceptResults( false );
+
+  mWebProfile->Prewarm();
+  QElapsedTimer timer;
+  timer.start();
+  while( mServer->connections == 0 && timer.elapsed() < WEB_PROFILE_TEST_TIMEOUT ) {
+    QCoreApplication::processEvents( QEventLoop::AllEvents, 10 );
+  }
+  ASSERT_EQ( mServer->connections, 1 );
+  EXPECT_TRUE( mServer->requests.isEmpty() );
+
+  qint64 acknowledged = -1;
+  QObject::connect( mWebProfile, &WebProfile::UploadAcknowledged, [&]( const QString&, qint64 msecs ) {
+    acknowledged = msecs;
+  });
+
+  mWebProfile->UploadResult( TestResult() );
+  ASSERT_TRUE( WaitForUploads( 1 ) );
+  EXPECT_EQ( mServer->connections, 1 );
+  EXPECT_GE( acknowledged, 0 );
+}
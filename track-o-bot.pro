@@ -2,7 +2,7 @@ TARGET = Track-o-Bot
 VERSION = 0.9.0
 
 CONFIG += qt precompile_header debug_and_release c++11
-QT += core widgets network xml
+QT += core widgets network xml concurrent
 
 DESTDIR = build
 OBJECTS_DIR = tmp
@@ -18,6 +18,7 @@ HEADERS = src/Local.h \
           src/ui/SettingsTab.h \
           src/ui/AccountTab.h \
           src/ui/LogTab.h \
+          src/ui/StatsTab.h \
           src/ui/AboutTab.h \
           src/ui/Overlay.h \
           src/Logger.h \
@@ -27,21 +28,29 @@ HEADERS = src/Local.h \
           src/HearthstoneLogLineHandler.h \
           src/HearthstoneCardDB.h \
           src/Hearthstone.h \
+          src/ReplayWindowCapture.h \
           src/MLP.h \
           src/RankClassifier.h \
           src/Settings.h \
           src/ResultTracker.h \
           src/ResultQueue.h \
+          src/UploadStats.h \
+          src/ResultJournal.h \
+          src/ResultStore.h \
+          src/ResultExporter.h \
+          src/ParquetWriter.h \
           src/Metadata.h \
           src/Trackobot.h
 
 SOURCES = src/Main.cpp \
           src/Hearthstone.cpp \
+          src/ReplayWindowCapture.cpp \
           src/WebProfile.cpp \
           src/ui/Window.cpp \
           src/ui/SettingsTab.cpp \
           src/ui/AccountTab.cpp \
           src/ui/LogTab.cpp \
+          src/ui/StatsTab.cpp \
           src/ui/AboutTab.cpp \
           src/ui/Overlay.cpp \
           src/Logger.cpp \
@@ -54,6 +63,11 @@ SOURCES = src/Main.cpp \
           src/Settings.cpp \
           src/ResultTracker.cpp \
           src/ResultQueue.cpp \
+          src/UploadStats.cpp \
+          src/ResultJournal.cpp \
+          src/ResultStore.cpp \
+          src/ResultExporter.cpp \
+          src/ParquetWriter.cpp \
           src/Local.cpp \
           src/Metadata.cpp \
           src/Trackobot.cpp
@@ -62,6 +76,7 @@ FORMS   = src/ui/MainWindow.ui \
           src/ui/SettingsWidget.ui \
           src/ui/AccountWidget.ui \
           src/ui/LogWidget.ui \
+          src/ui/StatsWidget.ui \
           src/ui/AboutWidget.ui \
           src/ui/Overlay.ui
 
@@ -69,6 +84,11 @@ DEFINES += VERSION=\\\"$$VERSION\\\"
 
 RESOURCES += resources.qrc
 
+# The rank classifier is embedded as the committed binary model
+# After changing the JSON, regenerate it with `make rank_classifier` (needs ruby)
+rank_classifier.commands = ruby $$PWD/dist/build_rank_classifier.rb $$PWD/data/rank_classifier.json $$PWD/data/rank_classifier.bin
+QMAKE_EXTRA_TARGETS += rank_classifier
+
 
 CONFIG(debug, debug|release): DEFINES += _DEBUG
 
@@ -122,15 +142,17 @@ win32 {
 unix {
     DEFINES += PLATFORM=\\\"linux\\\"
     HEADERS += src/LinuxWindowCapture.h \
+               src/LinuxProcessFinder.h \
                src/WineBottle.h \
                src/PeVersionExtractor.h
     SOURCES += src/LinuxWindowCapture.cpp \
+               src/LinuxProcessFinder.cpp \
                src/WineBottle.cpp \
                src/PeVersionExtractor.cpp
     RESOURCES = linux.qrc
     #LIBS +=  -lGL -lGLU -lxcb -lxcb-icccm -L/usr/lib/x86_64-linux-gnu/
     CONFIG += link_pkgconfig debug
-    PKGCONFIG += xcb xcb-icccm
+    PKGCONFIG += xcb xcb-icccm xcb-shm
     CODECFORSRC = UTF-8
     isEmpty(PREFIX){
         PREFIX = /usr/local